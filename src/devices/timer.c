@@ -17,9 +17,31 @@
 #error TIMER_FREQ <= 1000 recommended
 #endif
 
+/* 8254 input frequency divided by TIMER_FREQ, rounded to
+   nearest: the PIT count for one timer tick. */
+#define TICK_COUNT ((1193180 + TIMER_FREQ / 2) / TIMER_FREQ)
+
+/* Most ticks one one-shot count can cover (16-bit counter). */
+#define MAX_STRETCH (0xffff / TICK_COUNT)
+
 /* Number of timer ticks since OS booted. */
 static int64_t ticks;
 
+/* Tickless operation.  When nothing but the running thread (or
+   idle) can run, the PIT is switched from its periodic mode to a
+   one-shot count covering several ticks, up to the next sleep
+   deadline.  stretch_ticks is the number of ticks the pending
+   one-shot interrupt stands for, or 0 if none is pending.
+   Ticks are only ever added for time that has really passed, so
+   `ticks' stays exact; it is just updated less often.  While a
+   one-shot is pending, timer_ticks() adds the whole ticks the PIT
+   counter shows have passed since it was loaded. */
+static bool tickless;           /* Off until timer_calibrate() is done. */
+static int stretch_ticks;
+static int pit_mode;            /* Mode the PIT was last programmed in. */
+static int64_t ticks_handled;   /* Ticks already passed to thread_tick(). */
+static int64_t timer_interrupts;
+
 /* Number of loops per timer tick.
    Initialized by timer_calibrate(). */
 static unsigned loops_per_tick;
@@ -28,6 +50,10 @@ static intr_handler_func timer_interrupt;
 static bool too_many_loops (unsigned loops);
 static void busy_wait (int64_t loops);
 static void real_time_sleep (int64_t num, int32_t denom);
+static void pit_program (int mode, uint16_t count);
+static uint16_t pit_read (void);
+static int stretch_elapsed (void);
+static void timer_stretch (void);
 
 /* Sets up the 8254 Programmable Interval Timer (PIT) to
    interrupt PIT_FREQ times per second, and registers the
@@ -35,14 +61,7 @@ static void real_time_sleep (int64_t num, int32_t denom);
 void
 timer_init (void) 
 {
-  /* 8254 input frequency divided by TIMER_FREQ, rounded to
-     nearest. */
-  uint16_t count = (1193180 + TIMER_FREQ / 2) / TIMER_FREQ;
-
-  outb (0x43, 0x34);    /* CW: counter 0, LSB then MSB, mode 2, binary. */
-  outb (0x40, count & 0xff);
-  outb (0x40, count >> 8);
-
+  pit_program (2, TICK_COUNT);
   intr_register_ext (0x20, timer_interrupt, "8254 Timer");
 }
 
@@ -71,6 +90,9 @@ timer_calibrate (void)
       loops_per_tick |= test_bit;
 
   printf ("%'"PRIu64" loops/s.\n", (uint64_t) loops_per_tick * TIMER_FREQ);
+
+  /* Calibration needs a tick that really is one tick long. */
+  tickless = true;
 }
 
 /* Returns the number of timer ticks since the OS booted. */
@@ -79,6 +101,11 @@ timer_ticks (void)
 {
   enum intr_level old_level = intr_disable ();
   int64_t t = ticks;
+  if (stretch_ticks != 0) 
+    {
+      int elapsed = stretch_elapsed ();
+      t += elapsed < 0 ? stretch_ticks : elapsed / TICK_COUNT;
+    }
   intr_set_level (old_level);
   barrier ();
   return t;
@@ -131,27 +158,131 @@ timer_nsleep (int64_t ns)
 void
 timer_print_stats (void) 
 {
-  printf ("Timer: %"PRId64" ticks\n", timer_ticks ());
+  printf ("Timer: %"PRId64" ticks, %"PRId64" interrupts\n",
+          timer_ticks (), timer_interrupts);
 }
 
+/* Returns the PIT to one interrupt per tick if it is currently
+   stretched.  Called whenever a thread becomes ready or goes to
+   sleep, since either can need a tick sooner than the pending
+   one-shot would deliver it.
+
+   Whole ticks that have already passed are added to `ticks' right
+   away.  The counter is then loaded with the rest of the current
+   tick, so the next interrupt lands on the original tick
+   boundary and no time is lost. */
+void
+timer_unstretch (void) 
+{
+  int elapsed;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (stretch_ticks == 0)
+    return;
+
+  /* The one-shot already expired, so its interrupt is pending and
+     will account for all of it. */
+  elapsed = stretch_elapsed ();
+  if (elapsed < 0)
+    return;
+
+  ticks += elapsed / TICK_COUNT;
+  stretch_ticks = 1;
+  pit_program (0, TICK_COUNT - elapsed % TICK_COUNT);
+}
+
+/* Returns the PIT input cycles that have passed since the pending
+   one-shot was loaded, or -1 if it has already run out and its
+   interrupt is pending.  In mode 0 the counter stops at 0 only
+   for an instant and then wraps to 0xffff, above any count
+   timer_stretch() loads. */
+static int
+stretch_elapsed (void) 
+{
+  int programmed = stretch_ticks * TICK_COUNT;
+  int count = pit_read ();
+
+  ASSERT (stretch_ticks != 0);
+
+  if (count == 0 || count > programmed)
+    return -1;
+  return programmed - count;
+}
+
 /* Timer interrupt handler. */
 static void
 timer_interrupt (struct intr_frame *args UNUSED)
 {
-  ticks++;
-  thread_tick (timer_ticks());
+  int64_t prev = ticks_handled;
+  int elapsed;
+
+  timer_interrupts++;
+  ticks += stretch_ticks != 0 ? stretch_ticks : 1;
+  stretch_ticks = 0;
+  elapsed = ticks - ticks_handled;
+  ticks_handled = ticks;
+  thread_tick (ticks, elapsed);
 
+  /* A stretched interrupt can stand for several ticks, so the
+     periodic MLFQS updates fire on crossing their boundary rather
+     than on hitting it exactly. */
   if (thread_mlfqs) {
-    increase_recent_cpu();
-   if (ticks % TIMER_FREQ == 0 ) {
+    increase_recent_cpu(elapsed);
+   if (ticks / TIMER_FREQ != prev / TIMER_FREQ) {
       thread_calculate_load_avg();
       thread_calculate_recent_cpu ();
     }
 
-    if (ticks % 4 == 0) {
+    if (ticks / 4 != prev / 4) {
       thread_calculate_priority ();
     }
   }
+
+  timer_stretch ();
+}
+
+/* Decides how many ticks the next timer interrupt should cover
+   and programs the PIT for it. */
+static void
+timer_stretch (void) 
+{
+  int64_t until = thread_next_event ();
+  int n = 1;
+
+  if (tickless && until > ticks)
+    n = until - ticks < MAX_STRETCH ? until - ticks : MAX_STRETCH;
+
+  if (n > 1)
+    {
+      stretch_ticks = n;
+      pit_program (0, n * TICK_COUNT);
+    }
+  else if (pit_mode != 2)
+    pit_program (2, TICK_COUNT);
+}
+
+/* Loads PIT counter 0 with COUNT in MODE: 0 interrupts once when
+   the count runs out, 2 interrupts every COUNT input cycles. */
+static void
+pit_program (int mode, uint16_t count) 
+{
+  outb (0x43, 0x30 | (mode << 1)); /* CW: counter 0, LSB then MSB, binary. */
+  outb (0x40, count & 0xff);
+  outb (0x40, count >> 8);
+  pit_mode = mode;
+}
+
+/* Returns the current value of PIT counter 0. */
+static uint16_t
+pit_read (void) 
+{
+  uint8_t lo, hi;
+
+  outb (0x43, 0x00);    /* Counter latch command for counter 0. */
+  lo = inb (0x40);
+  hi = inb (0x40);
+  return lo | (hi << 8);
 }
 
 /* Returns true if LOOPS iterations waits for more than one timer
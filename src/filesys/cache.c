@@ -21,27 +21,49 @@ struct lock cache_lock;
 void cache_init() {
 	list_init(&cache_list);
 	lock_init(&cache_lock);
+	lock_set_name(&cache_lock, "cache");
 }
 
-void cache_read(disk_sector_t sec_no, void *buffer) {
-	//printf("cache read\n");
-
-	/*for sync, first, acquire the lock */
+/*Find sec_no in cache list, or NULL. Called with cache_lock held*/
+static struct cache *cache_find(disk_sector_t sec_no) {
 	struct list_elem *e;
-	struct cache *cache = NULL;
-	struct cache *imsi;
-
-	/*search the cache list and check the sec_no is equal*/
-	for (e=list_begin(&cache_list); e!=list_end(&cache_list); e=list_next(e)) {	
-		imsi = list_entry(e, struct cache, cache_elem);
-
-		/*if the sec_no is equal the number in the sec_no of the list_elem,
-		  this implies we've stored this data in cache.*/
-		if (imsi->sec_no == sec_no) {
-			cache = imsi;
-			break;
-		}
+
+	for (e=list_begin(&cache_list); e!=list_end(&cache_list); e=list_next(e)) {
+		struct cache *imsi = list_entry(e, struct cache, cache_elem);
+		if (imsi->sec_no == sec_no)
+			return imsi;
 	}
+	return NULL;
+}
+
+/*Tell whether sec_no is held in the cache, without reading it in*/
+bool cache_lookup(disk_sector_t sec_no) {
+	bool found;
+
+	lock_acquire(&cache_lock);
+	found = cache_find(sec_no) != NULL;
+	lock_release(&cache_lock);
+	return found;
+}
+
+/*Copy sec_no into buffer only if it is already cached. Never reads
+  the disk, evicts, or counts as an access. Returns false on a miss*/
+bool cache_peek(disk_sector_t sec_no, void *buffer) {
+	struct cache *cache;
+
+	lock_acquire(&cache_lock);
+	cache = cache_find(sec_no);
+	if (cache != NULL)
+		memcpy(buffer, cache->data, DISK_SECTOR_SIZE);
+	lock_release(&cache_lock);
+	return cache != NULL;
+}
+
+/*Return the cache entry for sec_no, adding one if it is not cached
+  yet. With LOAD the sector is read in from disk, otherwise the caller
+  is about to overwrite all of it. Called with cache_lock held*/
+static struct cache *cache_get(disk_sector_t sec_no, bool load) {
+	struct cache *cache = cache_find(sec_no);
 
 	/*nothing matched in cache list */
 	if (cache == NULL) {
@@ -51,88 +73,58 @@ void cache_read(disk_sector_t sec_no, void *buffer) {
 			cache_evict();
 		}
 
-		/*we need to read from (filesys) disk and add this part 
-		into cache list.*/
-
 		cache = (struct cache *)malloc(sizeof(struct cache));
-    	cache->dirty = false;
-    	cache->sec_no = sec_no;
-    	cache->data = malloc(DISK_SECTOR_SIZE);
-
-    	lock_acquire(&cache_lock);
-    	/*Read the data from filesys_disk, since no match in cache_list*/
-    	disk_read(filesys_disk, cache->sec_no, cache->data);
-	  	lock_release(&cache_lock);
-  
-
-    	/*Now, add this created cache into cache list. */
-    	list_push_back(&cache_list, &cache->cache_elem);
-	}
+		cache->dirty = false;
+		cache->sec_no = sec_no;
+		cache->data = malloc(DISK_SECTOR_SIZE);
 
-	/*Copy the data at buffer from cache we find*/
-  	memcpy(buffer, cache->data, DISK_SECTOR_SIZE);
+		/*Read the data from filesys_disk, since no match in cache_list*/
+		if (load)
+			disk_read(filesys_disk, cache->sec_no, cache->data);
 
-  	/*Now, cache is accessed (for eviction)*/
-  	cache->accessed = true; 
+		/*Now, add this created cache into cache list. */
+		list_push_back(&cache_list, &cache->cache_elem);
+	}
 
-	/*Now, release the lock*/
+	/*Now, cache is accessed (for eviction)*/
+	cache->accessed = true;
+	return cache;
 }
 
-void cache_write(disk_sector_t sec_no, const void *buffer) {
-
-	//printf("cache write\n");
-	/*for sync, first, acquire the lock */
-	struct list_elem *e;
-	struct cache *cache = NULL;
-	struct cache *imsi;
-
-	/*search the cache list and check the sec_no is equal*/
-	for (e=list_begin(&cache_list); e!=list_end(&cache_list); e=list_next(e)) {	
-		imsi = list_entry(e, struct cache, cache_elem);
-
-		/*if the sec_no is equal the number in the sec_no of the list_elem,
-		  this implies we've stored this data in cache.*/
-		if (imsi->sec_no == sec_no) {
-			cache = imsi;
-			break;
-		}
-	}
+/*
+ * Callers share the file system lock for reading, so every walk or
+ * change of cache_list, and every copy in or out of an entry, is done
+ * holding cache_lock.  An entry is only freed by cache_evict() under
+ * the same lock, so one found here stays valid until it is released.
+ */
+void cache_read(disk_sector_t sec_no, void *buffer) {
+	struct cache *cache;
 
-	/*nothing matched in cache list */
-	if (cache == NULL) {
+	lock_acquire(&cache_lock);
+	cache = cache_get(sec_no, true);
 
-		/*check cache list is already full (equal to 64) */
-		if (list_size(&cache_list) == MAX_CACHE_NUM ) {
-			cache_evict();
-		}
-
-		/*We need to add new cache, for saving datas in buffer*/
+	/*Copy the data at buffer from cache we find*/
+	memcpy(buffer, cache->data, DISK_SECTOR_SIZE);
+	lock_release(&cache_lock);
+}
 
-		cache = (struct cache *) malloc(sizeof(struct cache));
-    	cache->dirty = false;
-    	cache->sec_no = sec_no;
-    	cache->data = malloc(DISK_SECTOR_SIZE);
+void cache_write(disk_sector_t sec_no, const void *buffer) {
+	struct cache *cache;
 
- 
- 	  	/*Now, add this created cache into cache list. */
-    	list_push_back(&cache_list, &cache->cache_elem);
-	}
+	lock_acquire(&cache_lock);
+	cache = cache_get(sec_no, false);
 
 	/*Copy the data at cache from buffer*/
-  	memcpy(cache->data, buffer, DISK_SECTOR_SIZE);
-
-  	/*to pin whether it has been written or not*/
-  	cache->dirty = true;
+	memcpy(cache->data, buffer, DISK_SECTOR_SIZE);
 
-  	/*Now, cache is accessed (for eviction)*/
-  	cache->accessed = true; 
-
-	/*Now, release the lock*/
+	/*to pin whether it has been written or not*/
+	cache->dirty = true;
+	lock_release(&cache_lock);
 }
 
 void cache_close() {
 	//printf("cache close\n");
-	if (list_empty(&cache_list)) return;
+	lock_acquire(&cache_lock);
 
 	/*Delete all elements from cache list*/
 	while(!list_empty(&cache_list)) {
@@ -142,19 +134,21 @@ void cache_close() {
 		/*If this bit is true, then we need to update this new
 		  written date into filesys_disk*/
 		if (cache->dirty == true) {
-			 lock_acquire(&cache_lock);
 		     disk_write(filesys_disk, cache->sec_no, cache->data);
-		     lock_release(&cache_lock);
 		}
 
 		/*Free that we malloced*/
 		free(cache->data);
 		free(cache);
 	}
+	lock_release(&cache_lock);
 }
 
+/*Write back and drop one entry by the clock algorithm. Called with
+  cache_lock held*/
 void cache_evict() {
 	//printf("eviction start\n");
+	ASSERT(lock_held_by_current_thread(&cache_lock));
 	if (list_empty(&cache_list)) return;
 
 	/*initial setting for clock algo.*/
@@ -174,9 +168,7 @@ void cache_evict() {
 			list_remove(e);
 			
 			if (tmp->dirty == true) {
-				lock_acquire(&cache_lock);
 				disk_write(filesys_disk, tmp->sec_no, tmp->data);
-				lock_release(&cache_lock);
 			}
 
 			free(tmp->data);
@@ -4,6 +4,8 @@
 void cache_init(void);
 void cache_read(disk_sector_t sec_no, void *buffer);
 void cache_write(disk_sector_t sec_no, const void *buffer);
+bool cache_lookup(disk_sector_t sec_no);
+bool cache_peek(disk_sector_t sec_no, void *buffer);
 void cache_close(void);
 void cache_evict(void);
 
@@ -7,6 +7,8 @@
 #include "filesys/free-map.h"
 #include "threads/malloc.h"
 #include "filesys/cache.h"
+#include "threads/interrupt.h"
+#include "threads/synch.h"
 #include <stdio.h>
 
 /* Identifies an inode. */
@@ -62,6 +64,30 @@ static disk_sector_t convert_sector_from_index(off_t index, const struct inode_d
   }
 }
 
+/* Like convert_sector_from_index(), but only looks at index blocks
+   that are already in the buffer cache, so it never reads the disk
+   or evicts anything.  Returns -1 if one is not cached. */
+static disk_sector_t cached_sector_from_index(off_t index, const struct inode_disk *idisk) {
+  struct indirect_blocks *indirect_idisk;
+  disk_sector_t sector = -1;
+
+  if (index < DIRECT_BLOCK_CNT)
+    return idisk->direct_block[index];
+
+  off_t first_index  = (index - DIRECT_BLOCK_CNT) / DOUBLE_INDIRECT_CNT;
+  off_t second_index = (index - DIRECT_BLOCK_CNT) % DOUBLE_INDIRECT_CNT;
+
+  indirect_idisk = malloc(sizeof(struct indirect_blocks));
+  if (indirect_idisk == NULL)
+    return -1;
+  if (cache_peek (idisk->double_indirect_block, indirect_idisk)
+      && cache_peek (indirect_idisk->sector_block[first_index], indirect_idisk))
+    sector = indirect_idisk->sector_block[second_index];
+  free(indirect_idisk);
+
+  return sector;
+}
+
 /* Returns the number of sectors to allocate for an inode SIZE
    bytes long. */
 static inline size_t
@@ -286,11 +312,19 @@ static bool inode_disk_release(struct inode *inode) {
    returns the same `struct inode'. */
 static struct list open_inodes;
 
+/* Protects open_inodes.  Looking up an inode that is already
+   open, which is by far the common case, only reads it. */
+static struct rwlock open_inodes_lock;
+
+static struct inode *open_inodes_find (disk_sector_t);
+
 /* Initializes the inode module. */
 void
 inode_init (void) 
 {
   list_init (&open_inodes);
+  rwlock_init (&open_inodes_lock);
+  lock_set_name (&open_inodes_lock.lock, "open_inodes");
 }
 
 /* Initializes an inode with LENGTH bytes of data and
@@ -338,20 +372,14 @@ inode_create (disk_sector_t sector, off_t length, bool is_dir)
 struct inode *
 inode_open (disk_sector_t sector) 
 {
-  struct list_elem *e;
-  struct inode *inode;
+  struct inode *inode, *open;
 
   /* Check whether this inode is already open. */
-  for (e = list_begin (&open_inodes); e != list_end (&open_inodes);
-       e = list_next (e)) 
-    {
-      inode = list_entry (e, struct inode, elem);
-      if (inode->sector == sector) 
-        {
-          inode_reopen (inode);
-          return inode; 
-        }
-    }
+  rwlock_read_acquire (&open_inodes_lock);
+  inode = open_inodes_find (sector);
+  rwlock_read_release (&open_inodes_lock);
+  if (inode != NULL)
+    return inode;
 
   /* Allocate memory. */
   inode = malloc (sizeof *inode);
@@ -359,21 +387,56 @@ inode_open (disk_sector_t sector)
     return NULL;
 
   /* Initialize. */
-  list_push_front (&open_inodes, &inode->elem);
   inode->sector = sector;
   inode->open_cnt = 1;
   inode->deny_write_cnt = 0;
   inode->removed = false;
   cache_read (inode->sector, &inode->data);
+
+  /* Someone may have opened it while we were reading. */
+  rwlock_write_acquire (&open_inodes_lock);
+  open = open_inodes_find (sector);
+  if (open == NULL)
+    list_push_front (&open_inodes, &inode->elem);
+  rwlock_write_release (&open_inodes_lock);
+
+  if (open != NULL) 
+    {
+      free (inode);
+      return open;
+    }
   return inode;
 }
 
+/* Returns the open inode for SECTOR with its open count raised,
+   or a null pointer if it is not open.  open_inodes_lock must be
+   held in either mode. */
+static struct inode *
+open_inodes_find (disk_sector_t sector) 
+{
+  struct list_elem *e;
+
+  for (e = list_begin (&open_inodes); e != list_end (&open_inodes);
+       e = list_next (e)) 
+    {
+      struct inode *inode = list_entry (e, struct inode, elem);
+      if (inode->sector == sector) 
+        return inode_reopen (inode);
+    }
+  return NULL;
+}
+
 /* Reopens and returns INODE. */
 struct inode *
 inode_reopen (struct inode *inode)
 {
-  if (inode != NULL)
-    inode->open_cnt++;
+  /* Several readers of open_inodes_lock can get here at once. */
+  if (inode != NULL) 
+    {
+      enum intr_level old_level = intr_disable ();
+      inode->open_cnt++;
+      intr_set_level (old_level);
+    }
   //printf("reopen success\n");
   return inode;
 }
@@ -391,16 +454,24 @@ inode_get_inumber (const struct inode *inode)
 void
 inode_close (struct inode *inode) 
 {
+  enum intr_level old_level;
+  bool last;
+
   /* Ignore null pointer. */
   if (inode == NULL)
     return;
 
   /* Release resources if this was the last opener. */
-  if (--inode->open_cnt == 0)
+  rwlock_write_acquire (&open_inodes_lock);
+  old_level = intr_disable ();
+  last = --inode->open_cnt == 0;
+  intr_set_level (old_level);
+  if (last)
+    list_remove (&inode->elem);
+  rwlock_write_release (&open_inodes_lock);
+
+  if (last)
     {
-      /* Remove from inode list and release lock. */
-      list_remove (&inode->elem);
- 
       /* Deallocate blocks if removed. */
       if (inode->removed) 
         {
@@ -476,6 +547,31 @@ inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset)
   return bytes_read;
 }
 
+/* Returns true if every sector holding the SIZE bytes of INODE at
+   OFFSET is in the buffer cache, so that reading them needs no disk
+   access.  Bytes past the end of INODE are not checked.  Index
+   blocks are only consulted if they are cached too, so this never
+   reads the disk or evicts from the cache itself. */
+bool
+inode_cached (const struct inode *inode, off_t size, off_t offset)
+{
+  off_t pos;
+
+  for (pos = offset - offset % DISK_SECTOR_SIZE; pos < offset + size;
+       pos += DISK_SECTOR_SIZE)
+    {
+      disk_sector_t sector_idx;
+
+      if (pos >= inode->data.length)
+        break;
+      sector_idx = cached_sector_from_index (pos / DISK_SECTOR_SIZE,
+                                             &inode->data);
+      if (sector_idx == (disk_sector_t) -1 || !cache_lookup (sector_idx))
+        return false;
+    }
+  return true;
+}
+
 /* Writes SIZE bytes from BUFFER into INODE, starting at OFFSET.
    Returns the number of bytes actually written, which may be
    less than SIZE if end of file is reached or an error occurs.
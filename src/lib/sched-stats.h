@@ -0,0 +1,33 @@
+#ifndef __LIB_SCHED_STATS_H
+#define __LIB_SCHED_STATS_H
+
+#include <stdint.h>
+
+/* Buckets in the wakeup latency histogram.  Bucket 0 counts
+   threads that ran within the tick they were woken in, bucket
+   I > 0 those that waited 2**(I-1) to 2**I - 1 ticks.  The last
+   bucket also takes everything longer. */
+#define SCHED_LATENCY_BUCKETS 8
+
+/* Scheduler statistics returned by SYS_SCHED_STATS.
+   Times are in timer ticks. */
+struct sched_stats
+  {
+    /* The calling thread. */
+    int vol_switches;           /* Times it blocked. */
+    int invol_switches;         /* Times it was preempted. */
+    int donations;              /* Priority donations it received. */
+    int64_t ready_ticks;        /* Time ready but not running. */
+    int64_t blocked_ticks;      /* Time blocked. */
+
+    /* Its process, in pages. */
+    int rss;                    /* Frames mapped. */
+    int wss;                    /* Pages used during the last
+                                   revolution of the clock hand. */
+
+    /* The whole system: time from thread_unblock() until the
+       woken thread runs. */
+    unsigned wakeup_latency[SCHED_LATENCY_BUCKETS];
+  };
+
+#endif /* lib/sched-stats.h */
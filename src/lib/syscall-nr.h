@@ -28,7 +28,24 @@ enum
     SYS_MKDIR,                  /* Create a directory. */
     SYS_READDIR,                /* Reads a directory entry. */
     SYS_ISDIR,                  /* Tests if a fd represents a directory. */
-    SYS_INUMBER                 /* Returns the inode number for a fd. */
+    SYS_INUMBER,                /* Returns the inode number for a fd. */
+
+    /* Extensions. */
+    SYS_FORK,                   /* Duplicate the calling process. */
+    SYS_MSYNC,                  /* Write back a range of a memory mapping. */
+    SYS_MADVISE,                /* Give paging hints for a memory mapping. */
+    SYS_MMAP_POPULATE,          /* Map a file into memory, reading it now. */
+    SYS_EXEC_LIMITED,           /* Start a process with a resident-set limit. */
+    SYS_SCHED_STATS,            /* Read scheduler statistics. */
+    SYS_FUTEX_WAIT,             /* Sleep if a word holds a value. */
+    SYS_FUTEX_WAKE              /* Wake threads sleeping on a word. */
   };
 
+/* Advice values for SYS_MADVISE. */
+#define MADV_NORMAL 0           /* No special treatment. */
+#define MADV_RANDOM 1           /* Expect random access: no read-ahead. */
+#define MADV_SEQUENTIAL 2       /* Expect sequential access. */
+#define MADV_WILLNEED 3         /* Expect access soon: read in now. */
+#define MADV_DONTNEED 4         /* Not needed soon: write back, free. */
+
 #endif /* lib/syscall-nr.h */
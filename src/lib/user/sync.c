@@ -0,0 +1,120 @@
+#include <sync.h>
+#include <limits.h>
+#include <syscall.h>
+
+/* Atomically stores NEW in *P and returns the old value. */
+static inline int
+atomic_xchg (int *p, int new)
+{
+  asm volatile ("xchgl %0, %1" : "+r" (new), "+m" (*p) : : "memory");
+  return new;
+}
+
+/* Atomically stores NEW in *P if it holds OLD.  Returns the value
+   *P held before, which equals OLD on success. */
+static inline int
+atomic_cmpxchg (int *p, int old, int new)
+{
+  int prev;
+
+  asm volatile ("lock cmpxchgl %2, %1"
+                : "=a" (prev), "+m" (*p)
+                : "r" (new), "0" (old)
+                : "memory");
+  return prev;
+}
+
+/* Atomically adds 1 to *P. */
+static inline void
+atomic_inc (int *p)
+{
+  asm volatile ("lock incl %0" : "+m" (*p) : : "memory");
+}
+
+/* Initializes M as unlocked. */
+void
+mutex_init (struct mutex *m)
+{
+  m->state = 0;
+}
+
+/* Acquires M, sleeping in the kernel until it is free.
+
+   STATE is 0 when unlocked, 1 when locked with no one waiting,
+   and 2 when locked and someone may be waiting.  A locker that
+   finds the mutex taken sets it to 2 before sleeping, so the
+   holder knows to call futex_wake() on unlock; when it gets the
+   mutex that way it keeps the 2, since others may still sleep. */
+void
+mutex_lock (struct mutex *m)
+{
+  int c = atomic_cmpxchg (&m->state, 0, 1);
+
+  if (c == 0)
+    return;
+  if (c != 2)
+    c = atomic_xchg (&m->state, 2);
+  while (c != 0)
+    {
+      futex_wait (&m->state, 2);
+      c = atomic_xchg (&m->state, 2);
+    }
+}
+
+/* Acquires M if it is free, without sleeping.  Returns nonzero
+   if successful. */
+int
+mutex_trylock (struct mutex *m)
+{
+  return atomic_cmpxchg (&m->state, 0, 1) == 0;
+}
+
+/* Releases M, waking one sleeper if there may be any. */
+void
+mutex_unlock (struct mutex *m)
+{
+  if (atomic_xchg (&m->state, 0) == 2)
+    futex_wake (&m->state, 1);
+}
+
+/* Initializes CV. */
+void
+condvar_init (struct condvar *cv)
+{
+  cv->seq = 0;
+}
+
+/* Atomically releases M and waits for CV to be signaled, then
+   reacquires M.  As with any condition variable, the caller must
+   recheck its condition on return.
+
+   A signal that comes between reading SEQ and sleeping changes
+   SEQ, so futex_wait() returns at once instead of missing it.
+   M is retaken in the contended state, since other waiters woken
+   by a broadcast may be sleeping on it. */
+void
+condvar_wait (struct condvar *cv, struct mutex *m)
+{
+  int seq = cv->seq;
+
+  mutex_unlock (m);
+  futex_wait (&cv->seq, seq);
+  while (atomic_xchg (&m->state, 2) != 0)
+    futex_wait (&m->state, 2);
+}
+
+/* Wakes one thread waiting on CV, if any. */
+void
+condvar_signal (struct condvar *cv)
+{
+  atomic_inc (&cv->seq);
+  futex_wake (&cv->seq, 1);
+}
+
+/* Wakes all threads waiting on CV. */
+void
+condvar_broadcast (struct condvar *cv)
+{
+  atomic_inc (&cv->seq);
+  futex_wake (&cv->seq, INT_MAX);
+}
@@ -0,0 +1,35 @@
+#ifndef __LIB_USER_SYNC_H
+#define __LIB_USER_SYNC_H
+
+/* Mutexes and condition variables for user programs, built on
+   the futex_wait() and futex_wake() system calls.  Both live
+   entirely in user memory, so placing one in a shared file
+   mapping lets processes that map the file use it together. */
+
+/* Mutex.  Only enters the kernel when it is contended. */
+struct mutex
+  {
+    int state;          /* 0: unlocked, 1: locked, 2: locked, maybe waiters. */
+  };
+
+#define MUTEX_INITIALIZER { 0 }
+
+void mutex_init (struct mutex *);
+void mutex_lock (struct mutex *);
+int mutex_trylock (struct mutex *);
+void mutex_unlock (struct mutex *);
+
+/* Condition variable. */
+struct condvar
+  {
+    int seq;            /* Bumped by every signal and broadcast. */
+  };
+
+#define CONDVAR_INITIALIZER { 0 }
+
+void condvar_init (struct condvar *);
+void condvar_wait (struct condvar *, struct mutex *);
+void condvar_signal (struct condvar *);
+void condvar_broadcast (struct condvar *);
+
+#endif /* lib/user/sync.h */
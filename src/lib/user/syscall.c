@@ -182,3 +182,51 @@ inumber (int fd)
 {
   return syscall1 (SYS_INUMBER, fd);
 }
+
+pid_t
+fork (void)
+{
+  return syscall0 (SYS_FORK);
+}
+
+int
+msync (void *addr, size_t length)
+{
+  return syscall2 (SYS_MSYNC, addr, length);
+}
+
+int
+madvise (void *addr, size_t length, int advice)
+{
+  return syscall3 (SYS_MADVISE, addr, length, advice);
+}
+
+mapid_t
+mmap_populate (int fd, void *addr, bool lock)
+{
+  return syscall3 (SYS_MMAP_POPULATE, fd, addr, lock);
+}
+
+pid_t
+exec_limited (const char *file, size_t max_pages)
+{
+  return (pid_t) syscall2 (SYS_EXEC_LIMITED, file, max_pages);
+}
+
+int
+sched_stats (struct sched_stats *stats)
+{
+  return syscall1 (SYS_SCHED_STATS, stats);
+}
+
+int
+futex_wait (int *addr, int expected)
+{
+  return syscall2 (SYS_FUTEX_WAIT, addr, expected);
+}
+
+int
+futex_wake (int *addr, int n)
+{
+  return syscall2 (SYS_FUTEX_WAKE, addr, n);
+}
@@ -2,7 +2,10 @@
 #define __LIB_USER_SYSCALL_H
 
 #include <stdbool.h>
+#include <stddef.h>
 #include <debug.h>
+#include <syscall-nr.h>
+#include <sched-stats.h>
 
 /* Process identifier. */
 typedef int pid_t;
@@ -45,4 +48,14 @@ bool readdir (int fd, char name[READDIR_MAX_LEN + 1]);
 bool isdir (int fd);
 int inumber (int fd);
 
+/* Extensions. */
+pid_t fork (void);
+int msync (void *addr, size_t length);
+int madvise (void *addr, size_t length, int advice);
+mapid_t mmap_populate (int fd, void *addr, bool lock);
+pid_t exec_limited (const char *file, size_t max_pages);
+int sched_stats (struct sched_stats *);
+int futex_wait (int *addr, int expected);
+int futex_wake (int *addr, int n);
+
 #endif /* lib/user/syscall.h */
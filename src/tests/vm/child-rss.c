@@ -0,0 +1,33 @@
+/* Child process of exec-limited.
+   Fills a buffer several times larger than its resident-set limit,
+   reads it back, and checks that the pages it kept mapped stayed
+   within the limit. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE_CNT 64
+#define RSS_LIMIT 16
+
+static char buf[PAGE_CNT * 4096];
+
+void
+test_main (void)
+{
+  struct sched_stats stats;
+  size_t i;
+
+  for (i = 0; i < PAGE_CNT; i++)
+    memset (buf + i * 4096, i, 4096);
+  for (i = 0; i < sizeof buf; i++)
+    if (buf[i] != (char) (i / 4096))
+      fail ("byte %zu has wrong value %d", i, buf[i]);
+  msg ("touched %d pages", PAGE_CNT);
+
+  CHECK (sched_stats (&stats) == 0, "sched_stats");
+  if (stats.rss <= 0 || stats.rss > RSS_LIMIT)
+    fail ("rss is %d pages, limit %d", stats.rss, RSS_LIMIT);
+  msg ("rss within limit");
+}
@@ -0,0 +1,17 @@
+/* Runs child-rss with exec_limited() so that it may keep only a
+   few pages resident, while it touches many more than that.  The
+   child checks its data and its resident set size. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void)
+{
+  pid_t child;
+
+  CHECK ((child = exec_limited ("child-rss", 16)) != -1,
+         "exec_limited \"child-rss\"");
+  CHECK (wait (child) == 0, "wait for child (should return 0)");
+}
@@ -0,0 +1,16 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(exec-limited) begin
+(exec-limited) exec_limited "child-rss"
+(child-rss) begin
+(child-rss) touched 64 pages
+(child-rss) sched_stats
+(child-rss) rss within limit
+(child-rss) end
+(exec-limited) wait for child (should return 0)
+(exec-limited) end
+EOF
+pass;
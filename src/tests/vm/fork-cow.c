@@ -0,0 +1,53 @@
+/* Forks, then has the child overwrite pages of its data segment
+   and stack that it shares copy-on-write with the parent.  The
+   writes must go to the child's own copies, so the parent still
+   sees its original data afterward. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+static char buf[3 * 4096];
+
+/* Returns true if all SIZE bytes at P equal C. */
+static bool
+all_equal (const char *p, size_t size, char c) 
+{
+  size_t i;
+
+  for (i = 0; i < size; i++)
+    if (p[i] != c)
+      return false;
+  return true;
+}
+
+void
+test_main (void)
+{
+  char stack_buf[1024];
+  pid_t child;
+  int status;
+
+  memset (buf, 'p', sizeof buf);
+  memset (stack_buf, 'p', sizeof stack_buf);
+
+  child = fork ();
+  if (child == 0) 
+    {
+      if (!all_equal (buf, sizeof buf, 'p')
+          || !all_equal (stack_buf, sizeof stack_buf, 'p'))
+        fail ("child does not see the parent's data");
+      memset (buf, 'c', sizeof buf);
+      memset (stack_buf, 'c', sizeof stack_buf);
+      msg ("child overwrote its copy");
+      exit (81);
+    }
+  if (child == PID_ERROR)
+    fail ("fork");
+
+  status = wait (child);
+  CHECK (status == 81, "wait for child");
+  CHECK (all_equal (buf, sizeof buf, 'p'), "data segment unchanged");
+  CHECK (all_equal (stack_buf, sizeof stack_buf, 'p'), "stack unchanged");
+}
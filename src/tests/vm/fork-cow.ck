@@ -0,0 +1,15 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(fork-cow) begin
+(fork-cow) child overwrote its copy
+fork-cow: exit(81)
+(fork-cow) wait for child
+(fork-cow) data segment unchanged
+(fork-cow) stack unchanged
+(fork-cow) end
+fork-cow: exit(0)
+EOF
+pass;
@@ -0,0 +1,41 @@
+/* Maps a file, forks, and sleeps in futex_wait() on a word of the
+   mapping until the child, which shares the mapping, changes the
+   word and wakes it.  The child keeps calling futex_wake() until it
+   has actually woken the parent, so the wakeup that ends the wait
+   comes from the other process. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define ACTUAL ((void *) 0x10000000)
+
+void
+test_main (void)
+{
+  int *word = ACTUAL;
+  int handle;
+  pid_t child;
+
+  CHECK (create ("futex", 4096), "create \"futex\"");
+  CHECK ((handle = open ("futex")) > 1, "open \"futex\"");
+  CHECK (mmap (handle, ACTUAL) != MAP_FAILED, "mmap \"futex\"");
+  *word = 0;
+
+  child = fork ();
+  if (child == 0)
+    {
+      while (futex_wake (word, 1) == 0)
+        continue;
+      *word = 1;
+      futex_wake (word, 1);
+      exit (0);
+    }
+  CHECK (child > 0, "fork");
+
+  while (*word == 0)
+    futex_wait (word, 0);
+  msg ("woken by child");
+
+  CHECK (wait (child) == 0, "wait for child");
+}
@@ -0,0 +1,15 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(futex-wake) begin
+(futex-wake) create "futex"
+(futex-wake) open "futex"
+(futex-wake) mmap "futex"
+(futex-wake) fork
+(futex-wake) woken by child
+(futex-wake) wait for child
+(futex-wake) end
+EOF
+pass;
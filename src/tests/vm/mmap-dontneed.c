@@ -0,0 +1,40 @@
+/* Writes to a file through a mapping, then advises MADV_DONTNEED
+   so that the page is written back and dropped.  Reading through
+   the mapping again must fault the written data back in, and the
+   read system call must see it in the file. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/vm/sample.inc"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define ACTUAL ((void *) 0x10000000)
+
+void
+test_main (void)
+{
+  int handle;
+  mapid_t map;
+  char buf[1024];
+
+  CHECK (create ("sample.txt", strlen (sample)), "create \"sample.txt\"");
+  CHECK ((handle = open ("sample.txt")) > 1, "open \"sample.txt\"");
+  CHECK ((map = mmap (handle, ACTUAL)) != MAP_FAILED, "mmap \"sample.txt\"");
+  memcpy (ACTUAL, sample, strlen (sample));
+  CHECK (madvise (ACTUAL, 4096, MADV_DONTNEED) == 0,
+         "madvise \"sample.txt\" MADV_DONTNEED");
+
+  /* Re-read via the mapping. */
+  if (memcmp (ACTUAL, sample, strlen (sample)))
+    fail ("read of mmap'd file reported bad data");
+  msg ("compare mapped data against written data");
+
+  /* Read via read(). */
+  CHECK (read (handle, buf, strlen (sample)) == (int) strlen (sample),
+         "read \"sample.txt\"");
+  CHECK (!memcmp (buf, sample, strlen (sample)),
+         "compare read data against written data");
+  munmap (map);
+  close (handle);
+}
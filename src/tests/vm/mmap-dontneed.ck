@@ -0,0 +1,16 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(mmap-dontneed) begin
+(mmap-dontneed) create "sample.txt"
+(mmap-dontneed) open "sample.txt"
+(mmap-dontneed) mmap "sample.txt"
+(mmap-dontneed) madvise "sample.txt" MADV_DONTNEED
+(mmap-dontneed) compare mapped data against written data
+(mmap-dontneed) read "sample.txt"
+(mmap-dontneed) compare read data against written data
+(mmap-dontneed) end
+EOF
+pass;
@@ -0,0 +1,35 @@
+/* Writes to a file through a mapping and msyncs it, then unmaps
+   the file and checks with the read system call, through a new
+   file descriptor, that the synced data is in the file. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/vm/sample.inc"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define ACTUAL ((void *) 0x10000000)
+
+void
+test_main (void)
+{
+  int handle;
+  mapid_t map;
+  char buf[1024];
+
+  CHECK (create ("sample.txt", strlen (sample)), "create \"sample.txt\"");
+  CHECK ((handle = open ("sample.txt")) > 1, "open \"sample.txt\"");
+  CHECK ((map = mmap (handle, ACTUAL)) != MAP_FAILED, "mmap \"sample.txt\"");
+  memcpy (ACTUAL, sample, strlen (sample));
+  CHECK (msync (ACTUAL, strlen (sample)) == 0, "msync \"sample.txt\"");
+  munmap (map);
+  close (handle);
+
+  /* Read back via read(). */
+  CHECK ((handle = open ("sample.txt")) > 1, "reopen \"sample.txt\"");
+  CHECK (read (handle, buf, strlen (sample)) == (int) strlen (sample),
+         "read \"sample.txt\"");
+  CHECK (!memcmp (buf, sample, strlen (sample)),
+         "compare read data against written data");
+  close (handle);
+}
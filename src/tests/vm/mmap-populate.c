@@ -0,0 +1,76 @@
+/* Maps a file with mmap_populate(), first without and then with
+   locking the pages resident, and checks the data.  Then keeps
+   adding locked mappings of the file until one is refused, since
+   a process may lock only a share of the user pool, and checks
+   that unmapping one lets it lock again. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define SIZE (16 * 4096)
+#define MAX_MAPS 64
+
+static char page[4096];
+
+static void *
+map_addr (int i)
+{
+  return (void *) (0x10000000 + i * SIZE);
+}
+
+/* Checks that the SIZE bytes at ADDR hold the file's contents. */
+static void
+check_data (const char *addr)
+{
+  size_t ofs;
+
+  for (ofs = 0; ofs < SIZE; ofs++)
+    if (addr[ofs] != (char) ('a' + ofs / 4096))
+      fail ("byte %zu of mapping has wrong value %d", ofs, addr[ofs]);
+}
+
+void
+test_main (void)
+{
+  mapid_t maps[MAX_MAPS];
+  mapid_t map;
+  int handle;
+  int i;
+
+  CHECK (create ("populate", SIZE), "create \"populate\"");
+  CHECK ((handle = open ("populate")) > 1, "open \"populate\"");
+  for (i = 0; i < SIZE / 4096; i++)
+    {
+      memset (page, 'a' + i, sizeof page);
+      if (write (handle, page, sizeof page) != sizeof page)
+        fail ("write \"populate\" failed");
+    }
+
+  CHECK ((map = mmap_populate (handle, map_addr (0), false)) != MAP_FAILED,
+         "mmap_populate \"populate\" without lock");
+  check_data (map_addr (0));
+  munmap (map);
+
+  CHECK ((map = mmap_populate (handle, map_addr (0), true)) != MAP_FAILED,
+         "mmap_populate \"populate\" with lock");
+  check_data (map_addr (0));
+  munmap (map);
+
+  for (i = 0; i < MAX_MAPS; i++)
+    {
+      maps[i] = mmap_populate (handle, map_addr (i), true);
+      if (maps[i] == MAP_FAILED)
+        break;
+    }
+  CHECK (i > 0 && i < MAX_MAPS, "locked mappings are limited");
+  check_data (map_addr (i - 1));
+  munmap (maps[i - 1]);
+  CHECK ((maps[i - 1] = mmap_populate (handle, map_addr (i - 1), true))
+         != MAP_FAILED, "lock again after munmap");
+  check_data (map_addr (i - 1));
+  while (i-- > 0)
+    munmap (maps[i]);
+  close (handle);
+}
@@ -0,0 +1,15 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(mmap-populate) begin
+(mmap-populate) create "populate"
+(mmap-populate) open "populate"
+(mmap-populate) mmap_populate "populate" without lock
+(mmap-populate) mmap_populate "populate" with lock
+(mmap-populate) locked mappings are limited
+(mmap-populate) lock again after munmap
+(mmap-populate) end
+EOF
+pass;
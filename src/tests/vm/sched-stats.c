@@ -0,0 +1,55 @@
+/* Checks the counters returned by sched_stats(): all start out
+   sane, and forking a child and waiting for it block this thread,
+   so the number of voluntary switches and the wakeup latency
+   histogram both grow across them. */
+
+#include <sched-stats.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+/* Returns the number of wakeups in S's latency histogram. */
+static unsigned
+wakeup_cnt (const struct sched_stats *s)
+{
+  unsigned cnt = 0;
+  int i;
+
+  for (i = 0; i < SCHED_LATENCY_BUCKETS; i++)
+    cnt += s->wakeup_latency[i];
+  return cnt;
+}
+
+void
+test_main (void)
+{
+  struct sched_stats before, after;
+  pid_t child;
+
+  CHECK (sched_stats (&before) == 0, "sched_stats");
+  if (before.vol_switches < 0 || before.invol_switches < 0
+      || before.donations < 0 || before.ready_ticks < 0
+      || before.blocked_ticks < 0)
+    fail ("negative counter");
+  if (before.rss <= 0 || before.wss < 0)
+    fail ("rss %d, wss %d", before.rss, before.wss);
+  msg ("counters are sane");
+
+  child = fork ();
+  if (child == 0)
+    exit (0);
+  CHECK (child > 0, "fork");
+  CHECK (wait (child) == 0, "wait for child");
+
+  CHECK (sched_stats (&after) == 0, "sched_stats again");
+  if (after.vol_switches <= before.vol_switches)
+    fail ("voluntary switches went from %d to %d",
+          before.vol_switches, after.vol_switches);
+  msg ("voluntary switch counted");
+  if (after.blocked_ticks < before.blocked_ticks
+      || after.ready_ticks < before.ready_ticks)
+    fail ("time went backward");
+  if (wakeup_cnt (&after) <= wakeup_cnt (&before))
+    fail ("no wakeup latency recorded");
+  msg ("wakeup latency recorded");
+}
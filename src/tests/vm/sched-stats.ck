@@ -0,0 +1,16 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(sched-stats) begin
+(sched-stats) sched_stats
+(sched-stats) counters are sane
+(sched-stats) fork
+(sched-stats) wait for child
+(sched-stats) sched_stats again
+(sched-stats) voluntary switch counted
+(sched-stats) wakeup latency recorded
+(sched-stats) end
+EOF
+pass;
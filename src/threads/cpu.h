@@ -0,0 +1,41 @@
+#ifndef THREADS_CPU_H
+#define THREADS_CPU_H
+
+#include <stdint.h>
+
+/* Per-CPU state.
+
+   Pintos only ever runs on the boot processor, so there is a
+   single struct cpu and cpu_current() does not have to find out
+   which processor it is on.  State that each processor needs its
+   own copy of under SMP lives here rather than in file-scope
+   variables, so that bringing up more processors means raising
+   CPU_MAX and teaching cpu_current() to read the local APIC ID,
+   not hunting down globals. */
+#define CPU_MAX 1
+
+struct thread;
+
+struct cpu
+  {
+    unsigned id;                /* Index into cpus[]. */
+    struct thread *idle_thread; /* This processor's idle thread. */
+    unsigned thread_ticks;      /* # of timer ticks since last yield. */
+
+    /* Statistics. */
+    long long idle_ticks;       /* # of timer ticks spent idle. */
+    long long kernel_ticks;     /* # of timer ticks in kernel threads. */
+    long long user_ticks;       /* # of timer ticks in user programs. */
+  };
+
+extern struct cpu cpus[CPU_MAX];
+
+/* Returns the processor the caller is running on.  The answer is
+   only stable while interrupts are off. */
+static inline struct cpu *
+cpu_current (void)
+{
+  return &cpus[0];
+}
+
+#endif /* threads/cpu.h */
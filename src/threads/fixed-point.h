@@ -0,0 +1,62 @@
+#ifndef THREADS_FIXED_POINT_H
+#define THREADS_FIXED_POINT_H
+
+#include <stdint.h>
+
+/* 17.14 signed fixed-point arithmetic for the MLFQS scheduler.
+
+   A fixed-point number is kept in a plain int whose low FP_Q
+   bits are the fraction.  Everything here is inline and the
+   divisions by FP_F are by a power of 2, so the compiler turns
+   them into shifts; only fp_div() needs a real 64-bit divide. */
+
+#define FP_Q 14                         /* Fraction bits. */
+#define FP_F (1 << FP_Q)                /* 1.0 in fixed point. */
+
+/* Load average coefficients, 59/60 and 1/60. */
+#define FP_59_60 ((59 * FP_F) / 60)
+#define FP_1_60 (FP_F / 60)
+
+/* Converts integer N to fixed point. */
+static inline int
+int_to_fp (int n)
+{
+  return n * FP_F;
+}
+
+/* Converts X to an integer, rounding toward zero. */
+static inline int
+fp_to_int (int x)
+{
+  return x / FP_F;
+}
+
+/* Converts X to an integer, rounding to nearest. */
+static inline int
+fp_round (int x)
+{
+  return x >= 0 ? (x + FP_F / 2) / FP_F : (x - FP_F / 2) / FP_F;
+}
+
+/* Returns X + N, where N is an integer. */
+static inline int
+fp_add_int (int x, int n)
+{
+  return x + n * FP_F;
+}
+
+/* Returns X * Y. */
+static inline int
+fp_mul (int x, int y)
+{
+  return (int64_t) x * y / FP_F;
+}
+
+/* Returns X / Y. */
+static inline int
+fp_div (int x, int y)
+{
+  return (int64_t) x * FP_F / y;
+}
+
+#endif /* threads/fixed-point.h */
@@ -19,6 +19,7 @@
 #include "threads/malloc.h"
 #include "threads/palloc.h"
 #include "threads/pte.h"
+#include "threads/synch.h"
 #include "threads/thread.h"
 #ifdef USERPROG
 #include "userprog/process.h"
@@ -43,6 +44,10 @@ size_t ram_pages;
 /* Page directory with kernel mappings only. */
 uint32_t *base_page_dir;
 
+/* CPUID leaf 1 EDX bit and CR4 bit for global pages. */
+#define CPUID_PGE (1 << 13)
+#define CR4_PGE 0x00000080
+
 #ifdef FILESYS
 /* -f: Format the file system? */
 static bool format_filesys;
@@ -52,6 +57,7 @@ static bool format_filesys;
 bool power_off_when_done;
 
 static void ram_init (void);
+static bool cpu_has_pge (void);
 static void paging_init (void);
 
 static char **read_command_line (void);
@@ -122,6 +128,7 @@ main (void)
 
 #ifdef VM
   swap_init();
+  frame_reclaim_init();
 #endif
 
   printf ("Boot complete.\n");
@@ -167,6 +174,7 @@ paging_init (void)
   uint32_t *pd, *pt;
   size_t page;
   extern char _start, _end_kernel_text;
+  bool global = cpu_has_pge ();
 
   pd = base_page_dir = palloc_get_page (PAL_ASSERT | PAL_ZERO);
   pt = NULL;
@@ -185,6 +193,8 @@ paging_init (void)
         }
 
       pt[pte_idx] = pte_create_kernel (vaddr, !in_kernel_text);
+      if (global)
+        pt[pte_idx] |= PTE_G;
     }
 
   /* Store the physical address of the page directory into CR3
@@ -193,6 +203,29 @@ paging_init (void)
      to/from Control Registers" and [IA32-v3a] 3.7.5 "Base Address
      of the Page Directory". */
   asm volatile ("movl %0, %%cr3" : : "r" (vtop (base_page_dir)));
+
+  /* The kernel half of every page directory is the same, so mark
+     its mappings global.  With CR4.PGE set they stay in the TLB
+     when process_activate() loads another process's page
+     directory.  See [IA32-v3a] 3.12 "Translation Lookaside
+     Buffers (TLBs)". */
+  if (global)
+    {
+      uint32_t cr4;
+      asm volatile ("movl %%cr4, %0" : "=r" (cr4));
+      asm volatile ("movl %0, %%cr4" : : "r" (cr4 | CR4_PGE) : "memory");
+    }
+}
+
+/* Returns true if the CPU supports global pages, according to
+   CPUID.  See [IA32-v2a] "CPUID--CPU Identification". */
+static bool
+cpu_has_pge (void)
+{
+  uint32_t eax, ebx, ecx, edx;
+
+  asm ("cpuid" : "=a" (eax), "=b" (ebx), "=c" (ecx), "=d" (edx) : "a" (1));
+  return (edx & CPUID_PGE) != 0;
 }
 
 /* Breaks the kernel command line into words and returns them as
@@ -396,6 +429,7 @@ print_stats (void)
 {
   timer_print_stats ();
   thread_print_stats ();
+  lock_print_stats ();
 #ifdef FILESYS
   disk_print_stats ();
 #endif
@@ -0,0 +1,76 @@
+#ifndef THREADS_SPINLOCK_H
+#define THREADS_SPINLOCK_H
+
+#include <debug.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include "threads/cpu.h"
+#include "threads/interrupt.h"
+
+/* Busy-waiting lock for data shared with interrupt handlers and,
+   under SMP, with other processors.
+
+   Disabling interrupts is enough to keep other code on the same
+   processor out, so a spinlock may only be taken with interrupts
+   off and must not be held across anything that sleeps.  The
+   atomic exchange is what keeps other processors out; on a
+   uniprocessor it never spins, and a lock found taken by the
+   same processor is a recursive acquisition, which is caught
+   instead of hanging. */
+struct spinlock
+  {
+    volatile uint32_t locked;   /* Nonzero while held. */
+    struct cpu *cpu;            /* Holding processor, for debugging. */
+    const char *name;           /* Name, for debugging. */
+  };
+
+/* Initializes LOCK, calling it NAME. */
+static inline void
+spinlock_init (struct spinlock *lock, const char *name)
+{
+  lock->locked = 0;
+  lock->cpu = NULL;
+  lock->name = name;
+}
+
+/* Returns true if the running processor holds LOCK. */
+static inline bool
+spin_held (const struct spinlock *lock)
+{
+  return lock->locked && lock->cpu == cpu_current ();
+}
+
+/* Acquires LOCK, spinning until it is free.  Interrupts must be
+   off. */
+static inline void
+spin_lock (struct spinlock *lock)
+{
+  uint32_t taken;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+  ASSERT (!spin_held (lock));
+
+  for (;;)
+    {
+      taken = 1;
+      asm volatile ("xchgl %0, %1" : "+r" (taken), "+m" (lock->locked)
+                    : : "memory");
+      if (!taken)
+        break;
+      while (lock->locked)
+        asm volatile ("pause");
+    }
+  lock->cpu = cpu_current ();
+}
+
+/* Releases LOCK, which the running processor must hold. */
+static inline void
+spin_unlock (struct spinlock *lock)
+{
+  ASSERT (spin_held (lock));
+
+  lock->cpu = NULL;
+  asm volatile ("movl $0, %0" : "=m" (lock->locked) : : "memory");
+}
+
+#endif /* threads/spinlock.h */
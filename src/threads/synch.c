@@ -31,6 +31,7 @@
 #include <string.h>
 #include "threads/interrupt.h"
 #include "threads/thread.h"
+#include "devices/timer.h"
 
 /* Initializes semaphore SEMA to VALUE.  A semaphore is a
    nonnegative integer along with two atomic operators for
@@ -69,8 +70,7 @@ sema_down (struct semaphore *sema)
   old_level = intr_disable ();
   while (sema->value == 0) 
     {
-      //list_push_back (&sema->waiters, &thread_current ()->elem);
-      list_insert_ordered(&sema->waiters, &thread_current()->elem, priority_compare, 0);
+      list_push_back (&sema->waiters, &thread_current ()->elem);
       thread_block ();
     }
   sema->value--;
@@ -119,9 +119,13 @@ sema_up (struct semaphore *sema)
   old_level = intr_disable ();
   
   if (!list_empty (&sema->waiters)) {
-    list_sort(&(sema->waiters), priority_compare, 0); /*We need to consider why this sort is mandatory*/
-    thread_unblock (t = list_entry (list_pop_front (&sema->waiters),
-                                struct thread, elem));
+    /* Waiters' priorities can change through donation while they
+       sleep, so pick the highest one now instead of keeping the
+       list sorted.  list_min() returns the first of equals, which
+       keeps waiters of the same priority in FIFO order. */
+    struct list_elem *e = list_min (&sema->waiters, priority_compare, 0);
+    list_remove (e);
+    thread_unblock (t = list_entry (e, struct thread, elem));
   }
   sema->value++;
 
@@ -188,6 +192,12 @@ lock_init (struct lock *lock)
   lock->holder = NULL;
   lock->priority = 0;
   sema_init (&lock->semaphore, 1);
+#ifdef LOCK_PROFILE
+  lock->name = NULL;
+  lock->acquire_cnt = lock->contended_cnt = 0;
+  lock->wait_ticks = lock->max_wait = lock->max_hold = 0;
+  lock->acquired_at = 0;
+#endif
 }
 
 /* Acquires LOCK, sleeping until it becomes available if
@@ -210,17 +220,30 @@ lock_acquire (struct lock *lock)
 
   struct thread *cur = thread_current();
   cur->hurdle = lock;
-  if (lock->holder == NULL) lock->priority = cur->priority;
-    
+#ifdef LOCK_PROFILE
+  bool contended = lock->semaphore.value == 0;
+  int64_t start = contended ? timer_ticks () : 0;
+#endif
 
   if(!thread_mlfqs && lock->holder) {
     priority_donation(lock);
   }
   sema_down (&lock->semaphore);
   lock->holder = cur;
+#ifdef LOCK_PROFILE
+  lock->acquire_cnt++;
+  lock->acquired_at = timer_ticks ();
+  if (contended) {
+    int64_t wait = lock->acquired_at - start;
+    lock->contended_cnt++;
+    lock->wait_ticks += wait;
+    if (wait > lock->max_wait)
+      lock->max_wait = wait;
+  }
+#endif
   lock->holder->hurdle = NULL; // Now, acquired
-  if(!thread_mlfqs && lock->holder) {
-  list_insert_ordered(&lock->holder->lock_list, &lock->lock_elem, lock_priority_compare, 0);
+  if(!thread_mlfqs) {
+    lock_hold(lock);
   }
   intr_set_level(old_level);
 }
@@ -239,9 +262,18 @@ lock_try_acquire (struct lock *lock)
   ASSERT (lock != NULL);
   ASSERT (!lock_held_by_current_thread (lock));
 
+  enum intr_level old_level = intr_disable ();
   success = sema_try_down (&lock->semaphore);
-  if (success)
+  if (success) {
     lock->holder = thread_current ();
+#ifdef LOCK_PROFILE
+    lock->acquire_cnt++;
+    lock->acquired_at = timer_ticks ();
+#endif
+    if (!thread_mlfqs)
+      lock_hold (lock);
+  }
+  intr_set_level (old_level);
   return success;
 }
 
@@ -259,6 +291,11 @@ lock_release (struct lock *lock)
 
   enum intr_level old_level = intr_disable();
 
+#ifdef LOCK_PROFILE
+  int64_t hold = timer_ticks () - lock->acquired_at;
+  if (hold > lock->max_hold)
+    lock->max_hold = hold;
+#endif
   lock->holder = NULL;
   sema_up (&lock->semaphore);
   if (!thread_mlfqs) {
@@ -279,6 +316,169 @@ lock_held_by_current_thread (const struct lock *lock)
   return lock->holder == thread_current ();
 }
 
+#ifdef LOCK_PROFILE
+/* Named locks, reported by lock_print_stats(). */
+#define LOCK_PROFILE_MAX 32
+static struct lock *named_locks[LOCK_PROFILE_MAX];
+static int named_lock_cnt;
+
+/* Names LOCK so that its statistics are reported at shutdown.
+   LOCK must live until then. */
+void
+lock_set_name (struct lock *lock, const char *name) 
+{
+  enum intr_level old_level;
+
+  ASSERT (lock != NULL);
+  ASSERT (name != NULL);
+
+  old_level = intr_disable ();
+  if (lock->name == NULL && named_lock_cnt < LOCK_PROFILE_MAX)
+    named_locks[named_lock_cnt++] = lock;
+  lock->name = name;
+  intr_set_level (old_level);
+}
+
+/* Prints the statistics of every named lock, the ones waited on
+   longest first. */
+void
+lock_print_stats (void) 
+{
+  int i, j;
+
+  /* Insertion sort by total wait, descending. */
+  for (i = 1; i < named_lock_cnt; i++) 
+    {
+      struct lock *l = named_locks[i];
+      for (j = i; j > 0 && named_locks[j - 1]->wait_ticks < l->wait_ticks; j--)
+        named_locks[j] = named_locks[j - 1];
+      named_locks[j] = l;
+    }
+
+  printf ("Lock profile (ticks):\n");
+  printf ("  %-16s %10s %10s %10s %8s %8s\n",
+          "lock", "acquired", "contended", "wait", "max wait", "max hold");
+  for (i = 0; i < named_lock_cnt; i++) 
+    {
+      struct lock *l = named_locks[i];
+      printf ("  %-16s %10llu %10llu %10lld %8lld %8lld\n",
+              l->name, l->acquire_cnt, l->contended_cnt,
+              l->wait_ticks, l->max_wait, l->max_hold);
+    }
+}
+#endif /* LOCK_PROFILE */
+
+/* Initializes RW, a readers-writer lock.  Any number of readers
+   may hold it at once, or one writer alone.
+
+   A writer first takes RW's inner lock, which every reader also
+   has to pass through on the way in, and keeps it until it is
+   done.  So once a writer has arrived no new reader gets in, and
+   the writer only waits for the readers already inside to drain:
+   writers are preferred and cannot starve.  Readers and writers
+   that block behind a writer wait on an ordinary lock, so they
+   donate their priority to it.  A writer waiting for readers to
+   leave does not donate to them; reader sections are meant to be
+   short. */
+void
+rwlock_init (struct rwlock *rw) 
+{
+  ASSERT (rw != NULL);
+
+  lock_init (&rw->lock);
+  rw->readers = 0;
+  rw->writer_waiting = false;
+  sema_init (&rw->drained, 0);
+}
+
+/* Acquires RW for reading, sleeping while a writer holds or
+   waits for it.  A thread must not take RW for reading twice,
+   since a writer arriving in between would deadlock it. */
+void
+rwlock_read_acquire (struct rwlock *rw) 
+{
+  enum intr_level old_level;
+
+  ASSERT (rw != NULL);
+  ASSERT (!intr_context ());
+
+  lock_acquire (&rw->lock);
+  old_level = intr_disable ();
+  rw->readers++;
+  intr_set_level (old_level);
+  lock_release (&rw->lock);
+}
+
+/* Releases RW, held for reading by the current thread. */
+void
+rwlock_read_release (struct rwlock *rw) 
+{
+  enum intr_level old_level;
+
+  ASSERT (rw != NULL);
+
+  old_level = intr_disable ();
+  ASSERT (rw->readers > 0);
+  if (--rw->readers == 0 && rw->writer_waiting) 
+    {
+      rw->writer_waiting = false;
+      sema_up (&rw->drained);
+    }
+  intr_set_level (old_level);
+}
+
+/* Acquires RW for writing, sleeping until no other thread holds
+   it in either mode. */
+void
+rwlock_write_acquire (struct rwlock *rw) 
+{
+  enum intr_level old_level;
+
+  ASSERT (rw != NULL);
+  ASSERT (!intr_context ());
+
+  lock_acquire (&rw->lock);
+  old_level = intr_disable ();
+  while (rw->readers > 0) 
+    {
+      rw->writer_waiting = true;
+      sema_down (&rw->drained);
+    }
+  intr_set_level (old_level);
+}
+
+/* Tries to acquire RW for writing without sleeping.  Returns true
+   if successful, false if any other thread holds it in either
+   mode.  The current thread must not hold RW for writing; if it
+   holds it for reading, this fails. */
+bool
+rwlock_write_try_acquire (struct rwlock *rw) 
+{
+  enum intr_level old_level;
+  bool success;
+
+  ASSERT (rw != NULL);
+
+  if (!lock_try_acquire (&rw->lock))
+    return false;
+  old_level = intr_disable ();
+  success = rw->readers == 0;
+  intr_set_level (old_level);
+  if (!success)
+    lock_release (&rw->lock);
+  return success;
+}
+
+/* Releases RW, held for writing by the current thread. */
+void
+rwlock_write_release (struct rwlock *rw) 
+{
+  ASSERT (rw != NULL);
+  ASSERT (lock_held_by_current_thread (&rw->lock));
+
+  lock_release (&rw->lock);
+}
+
 /* One semaphore in a list. */
 struct semaphore_elem 
   {
@@ -372,52 +572,93 @@ cond_broadcast (struct condition *cond, struct lock *lock)
     cond_signal (cond, lock);
 }
 
-void priority_donation(struct lock *lock_donate) {
+/* Priority donation.
+
+   Each thread counts the locks it holds by their priority (the
+   highest priority donated through them) in held_cnt[], with bit
+   P of held_map set while held_cnt[P] is nonzero.  The priority a
+   thread inherits from its locks is then the highest set bit, so
+   releasing a lock or raising its priority costs O(1) however
+   many locks the thread holds. */
+
+/* Most holders a donation is passed along.  Deeper chains keep
+   the priority they had; this bounds the time spent with
+   interrupts off. */
+#define DONATION_DEPTH_MAX 8
+
+/* Counts LOCK, held by T, at its current priority. */
+static void held_add (struct thread *t, struct lock *lock) {
+  ASSERT (t->held_cnt[lock->priority] < UINT8_MAX);
+  if (t->held_cnt[lock->priority]++ == 0)
+    t->held_map |= (uint64_t) 1 << lock->priority;
+}
 
-  if (lock_donate == NULL) return;
+/* Undoes held_add(). */
+static void held_del (struct thread *t, struct lock *lock) {
+  ASSERT (t->held_cnt[lock->priority] > 0);
+  if (--t->held_cnt[lock->priority] == 0)
+    t->held_map &= ~((uint64_t) 1 << lock->priority);
+}
 
+/* Records that the current thread now holds LOCK.  The lock's
+   priority restarts from the threads still waiting for it, so a
+   donation from a thread that has since got the lock and let it
+   go is not carried over to the new holder. */
+void lock_hold (struct lock *lock) {
   struct thread *cur = thread_current();
-  struct thread *t = lock_donate->holder;
-
-  if (t == NULL) {
-    return;
-  }
-
-  if (t->priority >= cur->priority) return;
-  
-  priority_change (t, cur->priority);
+  struct list *waiters = &lock->semaphore.waiters;
 
-  if (lock_donate->priority < cur->priority) {
-    lock_donate->priority = cur->priority;
-  }
+  lock->priority = PRI_MIN;
+  if (!list_empty(waiters))
+    lock->priority = list_entry(list_min(waiters, priority_compare, 0),
+                                struct thread, elem)->priority;
 
-  lock_donate = t->hurdle;
-  priority_donation(lock_donate);
+  list_push_back(&cur->lock_list, &lock->lock_elem);
+  held_add(cur, lock);
 }
 
-void priority_donation_finished (struct lock *lock) {
+/* Passes the current thread's priority down the chain of holders
+   that starts at LOCK_DONATE, which the current thread is about
+   to wait on. */
+void priority_donation(struct lock *lock_donate) {
   struct thread *cur = thread_current();
+  int depth;
 
-  list_remove(&lock->lock_elem);
+  for (depth = 0; lock_donate != NULL && depth < DONATION_DEPTH_MAX; depth++) {
+    struct thread *t = lock_donate->holder;
 
-  if (list_empty(&cur->lock_list)) {
-    priority_change(cur, cur->original_priority);
-  }
-  else {
-    list_sort(&(cur->lock_list), lock_priority_compare, NULL); /*Need to be considered */
-    priority_change(cur, list_entry( list_front(&(cur->lock_list)), struct lock, lock_elem )->priority);  
+    if (t == NULL)
+      return;
+
+    if (lock_donate->priority < cur->priority) {
+      held_del(t, lock_donate);
+      lock_donate->priority = cur->priority;
+      held_add(t, lock_donate);
+    }
+
+    if (t->priority >= cur->priority)
+      return;
+
+    priority_change (t, cur->priority);
+    t->donations++;
 
+    lock_donate = t->hurdle;
   }
 }
 
-bool lock_priority_compare (struct list_elem *e1, struct list_elem *e2, void *aux UNUSED){
-  struct lock *a = list_entry (e1, struct lock, lock_elem);
-  struct lock *b = list_entry (e2, struct lock, lock_elem);
-  ASSERT(a!=NULL);
-  ASSERT(b!=NULL);
-  return a->priority > b->priority; 
-}
+/* Drops the donations the current thread received through LOCK,
+   which it has just released. */
+void priority_donation_finished (struct lock *lock) {
+  struct thread *cur = thread_current();
+  int priority = cur->original_priority;
 
+  list_remove(&lock->lock_elem);
+  held_del(cur, lock);
+
+  if (cur->held_map != 0 && priority_bitmap_max(cur->held_map) > priority)
+    priority = priority_bitmap_max(cur->held_map);
+  priority_change(cur, priority);
+}
 
 bool sema_priority_compare (struct list_elem *e1, struct list_elem *e2, void *aux UNUSED){
   return list_entry (e1, struct semaphore_elem, elem)->semaphore.priority > list_entry (e2, struct semaphore_elem, elem)->semaphore.priority; 
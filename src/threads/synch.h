@@ -1,8 +1,10 @@
 #ifndef THREADS_SYNCH_H
 #define THREADS_SYNCH_H
 
+#include <debug.h>
 #include <list.h>
 #include <stdbool.h>
+#include <stdint.h>
 
 /* A counting semaphore. */
 struct semaphore 
@@ -25,6 +27,15 @@ struct lock
     struct semaphore semaphore; /* Binary semaphore controlling access. */
     struct list_elem lock_elem;
     int priority;
+#ifdef LOCK_PROFILE
+    const char *name;           /* Name, or null if not profiled. */
+    uint64_t acquire_cnt;       /* Times acquired. */
+    uint64_t contended_cnt;     /* Times acquired after waiting. */
+    int64_t wait_ticks;         /* Total ticks spent waiting. */
+    int64_t max_wait;           /* Longest wait, in ticks. */
+    int64_t max_hold;           /* Longest hold, in ticks. */
+    int64_t acquired_at;        /* Tick of the last acquisition. */
+#endif
   };
 
 void lock_init (struct lock *);
@@ -33,6 +44,35 @@ bool lock_try_acquire (struct lock *);
 void lock_release (struct lock *);
 bool lock_held_by_current_thread (const struct lock *);
 
+/* Lock contention profiling.  Built only with LOCK_PROFILE
+   defined, e.g. "make LOCK_PROFILE=1"; otherwise these do
+   nothing.  Every lock counts its own statistics, and the ones
+   given a name are reported at shutdown. */
+#ifdef LOCK_PROFILE
+void lock_set_name (struct lock *, const char *name);
+void lock_print_stats (void);
+#else
+static inline void lock_set_name (struct lock *lock UNUSED,
+                                  const char *name UNUSED) {}
+static inline void lock_print_stats (void) {}
+#endif
+
+/* Readers-writer lock. */
+struct rwlock 
+  {
+    struct lock lock;           /* Held by the writer. */
+    int readers;                /* Readers inside. */
+    bool writer_waiting;        /* Writer waiting for readers to leave. */
+    struct semaphore drained;   /* Upped when the last reader leaves. */
+  };
+
+void rwlock_init (struct rwlock *);
+void rwlock_read_acquire (struct rwlock *);
+void rwlock_read_release (struct rwlock *);
+void rwlock_write_acquire (struct rwlock *);
+bool rwlock_write_try_acquire (struct rwlock *);
+void rwlock_write_release (struct rwlock *);
+
 /* Condition variable. */
 struct condition 
   {
@@ -52,7 +92,7 @@ void cond_broadcast (struct condition *, struct lock *);
 
 void priority_donation (struct lock *);
 void priority_donation_finished (struct lock *);
-bool lock_priority_compare (struct list_elem *, struct list_elem *, void *aux);
+void lock_hold (struct lock *);
 bool sema_priority_compare (struct list_elem *, struct list_elem *, void *aux);
 
 #define barrier() asm volatile ("" : : : "memory")
@@ -4,13 +4,17 @@
 #include <random.h>
 #include <stdio.h>
 #include <string.h>
+#include <sched-stats.h>
+#include "threads/fixed-point.h"
 #include "threads/flags.h"
 #include "threads/interrupt.h"
 #include "threads/intr-stubs.h"
 #include "threads/palloc.h"
+#include "threads/spinlock.h"
 #include "threads/switch.h"
 #include "threads/synch.h"
 #include "threads/vaddr.h"
+#include "devices/timer.h"
 #ifdef USERPROG
 #include "userprog/process.h"
 #include "userprog/syscall.h"
@@ -34,12 +38,18 @@
    Do not modify this value. */
 #define THREAD_BASIC 0xd42df210
 
-/* List of processes in THREAD_READY state, that is, processes
-   that are ready to run but not actually running. */
-static struct list ready_list;
+/* Processes in THREAD_READY state, that is, processes that are
+   ready to run but not actually running.  There is one FIFO queue
+   per priority, and bit P of ready_bitmap is set exactly when
+   ready_queues[P] is not empty, so the highest runnable priority
+   is found with a bit scan instead of walking a sorted list. */
+static struct list ready_queues[PRI_MAX + 1];
+static uint64_t ready_bitmap;
+static int ready_cnt;           /* # of threads in ready_queues. */
+static struct spinlock ready_lock; /* Protects the three above. */
 
-/* Idle thread. */
-static struct thread *idle_thread;
+/* Per-CPU state, see cpu.h. */
+struct cpu cpus[CPU_MAX];
 
 /* Initial thread, the thread running init.c:main(). */
 static struct thread *initial_thread;
@@ -56,17 +66,29 @@ struct kernel_thread_frame
     void *aux;                  /* Auxiliary data for function. */
   };
 
-/* Statistics. */
-static long long idle_ticks;    /* # of timer ticks spent idle. */
-static long long kernel_ticks;  /* # of timer ticks in kernel threads. */
-static long long user_ticks;    /* # of timer ticks in user programs. */
+/* Scheduler tracing.  Counters of threads that have exited are
+   folded into exited_stats so the totals at shutdown cover them. */
+static unsigned wakeup_latency[SCHED_LATENCY_BUCKETS];
+static struct sched_stats exited_stats;
 
 /* Scheduling. */
 #define TIME_SLICE 4            /* # of timer ticks to give each thread. */
-static unsigned thread_ticks;   /* # of timer ticks since last yield. */
 
-struct list sleep_list; /*List for sleeping threads*/
+/* Threads sleeping in timer_sleep(), hashed by wake-up tick into
+   a timer wheel.  Each slot is kept sorted by wake_up, so a slot
+   scan stops at the first thread that belongs to a later turn of
+   the wheel. */
+#define SLEEP_WHEEL_SLOTS 64    /* Must be a power of 2. */
+static struct list sleep_wheel[SLEEP_WHEEL_SLOTS];
+static int64_t sleep_wheel_now; /* Last tick the wheel was advanced to. */
+static int64_t next_wake_up;    /* Earliest wake_up on the wheel. */
 int load_avg;
+static struct semaphore decay_sema; /* Upped once a second for mlfqs_decay(). */
+static struct list_elem *decay_cursor; /* Next thread mlfqs_decay() visits. */
+
+/* List of all processes.  Processes are added to this list
+   when they are first scheduled and removed when they exit. */
+static struct list all_list;
 
 /* If false (default), use round-robin scheduler.
    If true, use multi-level feedback queue scheduler.
@@ -84,6 +106,16 @@ static void *alloc_frame (struct thread *, size_t size);
 static void schedule (void);
 void schedule_tail (struct thread *prev);
 static tid_t allocate_tid (void);
+static void ready_push (struct thread *);
+static void ready_remove (struct thread *);
+static int ready_max_priority (void);
+static void ready_requeue (struct thread *, int priority);
+static int mlfqs_priority (struct thread *);
+static void mlfqs_decay (void *aux);
+static void sched_stats_add (struct thread *, void *totals);
+static void sched_stats_print (struct thread *, void *aux);
+static bool wake_up_less (const struct list_elem *, const struct list_elem *,
+                          void *aux);
 
 /* Initializes the threading system by transforming the code
    that's currently running into a thread.  This can't work in
@@ -106,9 +138,22 @@ thread_init (void)
 {
   ASSERT (intr_get_level () == INTR_OFF);
 
+  int i;
+
   lock_init (&tid_lock);
-  list_init (&ready_list);
-  list_init (&sleep_list);
+  list_init (&all_list);
+  sema_init (&decay_sema, 0);
+  for (i = PRI_MIN; i <= PRI_MAX; i++)
+    list_init (&ready_queues[i]);
+  ready_bitmap = 0;
+  ready_cnt = 0;
+  spinlock_init (&ready_lock, "ready");
+  for (i = 0; i < CPU_MAX; i++)
+    cpus[i].id = i;
+  for (i = 0; i < SLEEP_WHEEL_SLOTS; i++)
+    list_init (&sleep_wheel[i]);
+  sleep_wheel_now = 0;
+  next_wake_up = INT64_MAX;
 
   /* Set up a thread structure for the running thread. */
   initial_thread = running_thread ();
@@ -137,38 +182,131 @@ thread_start (void)
 
   /* Wait for the idle thread to initialize idle_thread. */
   sema_down (&idle_started);
+
+  /* Create the thread that decays recent_cpu each second. */
+  if (thread_mlfqs)
+    thread_create ("decay", PRI_MAX, mlfqs_decay, NULL);
 }
 
 /* Called by the timer interrupt handler at each timer tick.
    Thus, this function runs in an external interrupt context. */
 void
-thread_tick (int64_t ticks) 
+thread_tick (int64_t ticks, int elapsed) 
 {
   struct thread *t = thread_current ();
+  struct cpu *c = cpu_current ();
 
   /* Update statistics. */
-  if (t == idle_thread)
-    idle_ticks++;
+  if (t == c->idle_thread)
+    c->idle_ticks += elapsed;
 #ifdef USERPROG
   else if (t->pagedir != NULL)
-    user_ticks++;
+    c->user_ticks += elapsed;
 #endif
   else
-    kernel_ticks++;
+    c->kernel_ticks += elapsed;
 
   /* Enforce preemption. */
-  if (++thread_ticks >= TIME_SLICE)
+  c->thread_ticks += elapsed;
+  if (c->thread_ticks >= TIME_SLICE)
     intr_yield_on_return ();
 
   awake_thread(ticks);
 }
 
+/* Invokes function 'func' on all threads, passing along 'aux'.
+   This function must be called with interrupts off. */
+void
+thread_foreach (thread_action_func *func, void *aux)
+{
+  struct list_elem *e;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  for (e = list_begin (&all_list); e != list_end (&all_list);
+       e = list_next (e))
+    {
+      struct thread *t = list_entry (e, struct thread, allelem);
+      func (t, aux);
+    }
+}
+
 /* Prints thread statistics. */
 void
 thread_print_stats (void) 
 {
+  struct sched_stats totals = exited_stats;
+  long long idle_ticks = 0, kernel_ticks = 0, user_ticks = 0;
+  enum intr_level old_level;
+  int i;
+
+  for (i = 0; i < CPU_MAX; i++)
+    {
+      idle_ticks += cpus[i].idle_ticks;
+      kernel_ticks += cpus[i].kernel_ticks;
+      user_ticks += cpus[i].user_ticks;
+    }
   printf ("Thread: %lld idle ticks, %lld kernel ticks, %lld user ticks\n",
           idle_ticks, kernel_ticks, user_ticks);
+
+  old_level = intr_disable ();
+  thread_foreach (sched_stats_add, &totals);
+  thread_foreach (sched_stats_print, NULL);
+  intr_set_level (old_level);
+
+  printf ("Scheduler: %d voluntary and %d involuntary switches, "
+          "%d donations, %lld ticks ready, %lld ticks blocked\n",
+          totals.vol_switches, totals.invol_switches, totals.donations,
+          totals.ready_ticks, totals.blocked_ticks);
+  printf ("Wakeup latency (ticks):");
+  for (i = 0; i < SCHED_LATENCY_BUCKETS; i++)
+    if (i <= 1)
+      printf (" %d: %u", i, wakeup_latency[i]);
+    else if (i < SCHED_LATENCY_BUCKETS - 1)
+      printf (" %d-%d: %u", 1 << (i - 1), (1 << i) - 1, wakeup_latency[i]);
+    else
+      printf (" %d+: %u", 1 << (i - 1), wakeup_latency[i]);
+  printf ("\n");
+}
+
+/* Fills STATS with the running thread's scheduler counters and
+   the system-wide wakeup latency histogram. */
+void
+thread_sched_stats (struct sched_stats *stats) 
+{
+  struct thread *cur = thread_current ();
+  enum intr_level old_level = intr_disable ();
+
+  stats->vol_switches = cur->vol_switches;
+  stats->invol_switches = cur->invol_switches;
+  stats->donations = cur->donations;
+  stats->ready_ticks = cur->ready_ticks;
+  stats->blocked_ticks = cur->blocked_ticks;
+  memcpy (stats->wakeup_latency, wakeup_latency, sizeof wakeup_latency);
+  intr_set_level (old_level);
+}
+
+/* Adds T's scheduler counters to TOTALS. */
+static void
+sched_stats_add (struct thread *t, void *totals_) 
+{
+  struct sched_stats *totals = totals_;
+
+  totals->vol_switches += t->vol_switches;
+  totals->invol_switches += t->invol_switches;
+  totals->donations += t->donations;
+  totals->ready_ticks += t->ready_ticks;
+  totals->blocked_ticks += t->blocked_ticks;
+}
+
+/* Prints T's scheduler counters. */
+static void
+sched_stats_print (struct thread *t, void *aux UNUSED) 
+{
+  printf ("Thread %d (%s): %d voluntary, %d involuntary, %d donations, "
+          "%lld ready, %lld blocked\n",
+          t->tid, t->name, t->vol_switches, t->invol_switches,
+          t->donations, t->ready_ticks, t->blocked_ticks);
 }
 
 /* Creates a new kernel thread named NAME with the given initial
@@ -194,6 +332,7 @@ thread_create (const char *name, int priority,
   struct kernel_thread_frame *kf;
   struct switch_entry_frame *ef;
   struct switch_threads_frame *sf;
+  enum intr_level old_level;
   tid_t tid;
 
   ASSERT (function != NULL);
@@ -226,8 +365,12 @@ thread_create (const char *name, int priority,
   sf = alloc_frame (t, sizeof *sf);
   sf->eip = switch_entry;
 
-  /* Add to run queue. */
+  /* Add to run queue.  Being created is not a wakeup, so it is kept
+     out of the wakeup latency histogram. */
+  old_level = intr_disable ();
   thread_unblock (t);
+  t->woken = false;
+  intr_set_level (old_level);
 
   test_max_priority();
 
@@ -267,9 +410,14 @@ thread_unblock (struct thread *t)
 
   old_level = intr_disable ();
   ASSERT (t->status == THREAD_BLOCKED);
-  //list_push_back (&ready_list, &t->elem);
-  list_insert_ordered(&ready_list, &t->elem, priority_compare, 0);
+  spin_lock (&ready_lock);
+  ready_push (t);
+  spin_unlock (&ready_lock);
   t->status = THREAD_READY;
+  t->blocked_ticks += timer_ticks () - t->state_since;
+  t->state_since = timer_ticks ();
+  t->woken = true;
+  timer_unstretch ();
   intr_set_level (old_level);
 }
 
@@ -326,6 +474,10 @@ thread_exit (void)
   /* Just set our status to dying and schedule another process.
      We will be destroyed during the call to schedule_tail(). */
   intr_disable ();
+  sched_stats_add (thread_current (), &exited_stats);
+  if (decay_cursor == &thread_current ()->allelem)
+    decay_cursor = list_next (decay_cursor);
+  list_remove (&thread_current ()->allelem);
   thread_current ()->status = THREAD_DYING;
   schedule ();
   NOT_REACHED ();
@@ -343,9 +495,12 @@ thread_yield (void)
 
   old_level = intr_disable ();
 
-  if (curr != idle_thread) 
-    //list_push_back (&ready_list, &curr->elem);
-    list_insert_ordered(&ready_list, &curr->elem, priority_compare, 0);
+  if (curr != cpu_current ()->idle_thread) 
+    {
+      spin_lock (&ready_lock);
+      ready_push (curr);
+      spin_unlock (&ready_lock);
+    }
 
   curr->status = THREAD_READY;
   schedule ();
@@ -362,12 +517,8 @@ thread_set_priority (int new_priority)
   if (cur->priority == cur->original_priority) cur->priority = new_priority;
   cur->original_priority = new_priority;
   
-  if (!list_empty (&ready_list)) {
-    struct thread *t = list_entry(list_begin(&ready_list), struct thread, elem);
-      if (t->priority > new_priority) {
-      thread_yield();
-    }
-  }
+  if (ready_max_priority () > cur->priority)
+    thread_yield ();
 }
 
 /* Returns the current thread's priority. */
@@ -388,9 +539,7 @@ thread_set_nice (int nice)
   thread_current()->nice = nice;
   thread_calculate_priority();
 
-  ASSERT(list_begin(&ready_list) != NULL)
-
-  if (thread_current()->priority <= list_entry(list_begin(&ready_list), struct thread, elem)->priority) {
+  if (thread_current()->priority <= ready_max_priority ()) {
     thread_yield();
   }
   intr_set_level (old_level);
@@ -431,109 +580,90 @@ thread_get_recent_cpu (void)
 
 
 void thread_calculate_load_avg (void) {
-  int64_t frac1 = (59 * (1<< 14)) / 60;
-  int64_t frac2 = (1 << 14) / 60;
-  int cnt = list_size(&ready_list);
+  int cnt = ready_cnt;
   
-  if (thread_current()!=idle_thread) cnt++;
+  if (thread_current()!=cpu_current ()->idle_thread) cnt++;
 
-  load_avg = ((int64_t)load_avg * frac1) / (1 << 14);
-  load_avg = ((int64_t)load_avg + cnt * frac2);
+  load_avg = fp_mul(FP_59_60, load_avg) + cnt * FP_1_60;
 	ASSERT (load_avg >= 0)
 }
 
+/* Called from the timer interrupt once per second.  Decaying
+   recent_cpu touches every thread, so it is left to the
+   mlfqs_decay() thread; the yield requested below lets it run as
+   soon as the interrupt returns. */
 void thread_calculate_recent_cpu (void) {
-  int64_t imsi;
-  struct list_elem *e;
-  struct thread *t; 
-
-
-  for (e=list_begin(&ready_list); e!=list_end(&ready_list); e=list_next(e)) {
-    imsi = load_avg;
-    t= list_entry(e, struct thread, elem);
+  ASSERT (intr_context ());
 
-    imsi *= 2;
-    imsi = imsi * (1 << 14) / (imsi + (1 << 14));
-    imsi = (int64_t)imsi * (t->recent_cpu) / (1<<14);
-
-    t->recent_cpu = imsi + t->nice * (1<<14);
-  }
-
-  for (e=list_begin(&sleep_list); e!=list_end(&sleep_list); e=list_next(e)) {
-    imsi = load_avg;
-    t= list_entry(e, struct thread, sleep_elem);
-
-    imsi *= 2;
-    imsi = imsi * (1 << 14) / (imsi + (1 << 14));
-    imsi = (int64_t)imsi * (t->recent_cpu) / (1<<14);
-    
-    t->recent_cpu = imsi + t->nice * (1<<14);
+  sema_up (&decay_sema);
+  intr_yield_on_return ();
 }
 
-  t = thread_current();
-  imsi = load_avg;
-
-  imsi *= 2;
-  imsi = imsi * (1 << 14) / (imsi + (1 << 14));
-  imsi = (int64_t)imsi * (t->recent_cpu) / (1<<14);
-  t->recent_cpu = imsi + t->nice * (1<<14);
 
+void increase_recent_cpu(int elapsed) {
+  if (thread_current() != cpu_current ()->idle_thread) thread_current()->recent_cpu = fp_add_int(thread_current()->recent_cpu, elapsed);
 }
 
-
-void increase_recent_cpu(void) {
-  if (thread_current() != idle_thread) thread_current()->recent_cpu += (1<<14);
-}
-
+/* Called every 4 ticks.  Between the per-second decays only the
+   running thread's recent_cpu changes (and only it can change its
+   own nice), so it is the only priority that can move. */
 void thread_calculate_priority(void) {
-  struct list_elem *e;
-  struct thread *t;
-  int64_t imsi;
-  int recent_cpu;
-  int nice;
-
-  for (e=list_begin(&ready_list); e!=list_end(&ready_list); e=list_next(e)) {
-    t = list_entry(e, struct thread, elem);
-
-    recent_cpu = t->recent_cpu;
-    nice = t->nice;
+  struct thread *cur = thread_current();
 
-    imsi = (PRI_MAX * (1<<14)) - (recent_cpu / 4);
-    imsi -= (nice * 2 * (1<<14));
+  if (cur == cpu_current ()->idle_thread) return;
 
-    t->priority = (imsi) / (1<<14);
-    if (t->priority <= PRI_MIN) t->priority = PRI_MIN;
-    if (t->priority >= PRI_MAX) t->priority = PRI_MAX;
+  cur->priority = mlfqs_priority(cur);
+  if (intr_context() && cur->priority < ready_max_priority())
+    intr_yield_on_return();
+}
 
-  }
+/* Returns the MLFQS priority of T from its recent_cpu and nice. */
+static int mlfqs_priority(struct thread *t) {
+  int priority;
 
-  for (e=list_begin(&sleep_list); e!=list_end(&sleep_list); e=list_next(e)) {
-    t = list_entry(e, struct thread, sleep_elem);
+  priority = fp_to_int(int_to_fp(PRI_MAX) - t->recent_cpu / 4 - int_to_fp(t->nice * 2));
+  if (priority <= PRI_MIN) priority = PRI_MIN;
+  if (priority >= PRI_MAX) priority = PRI_MAX;
+  return priority;
+}
 
-    recent_cpu = t->recent_cpu;
-    nice = t->nice;
+/* Thread that applies the per-second recent_cpu decay to every
+   thread, including those blocked on locks and semaphores, and
+   updates their priorities.  Ready threads change run queue only
+   if their priority actually moved.
 
-    imsi = (PRI_MAX * (1<<14)) - (recent_cpu / 4);
-    imsi -= (nice * 2 * (1<<14));
+   Interrupts are off only while one thread is updated, not for the
+   whole walk.  In between, DECAY_CURSOR holds our place in
+   all_list, and thread_exit() moves it past a thread that leaves. */
+static void mlfqs_decay(void *aux UNUSED) {
+  int coef;
+  struct thread *t;
 
-    t->priority = (imsi) / (1<<14);
-    if (t->priority <= PRI_MIN) t->priority = PRI_MIN;
-    if (t->priority >= PRI_MAX) t->priority = PRI_MAX;
+  for (;;) {
+    sema_down(&decay_sema);
+    intr_disable();
+
+    /* (2 * load_avg) / (2 * load_avg + 1), the same for every thread. */
+    coef = fp_div(2 * load_avg, 2 * load_avg + FP_F);
+
+    decay_cursor = list_begin(&all_list);
+    while (decay_cursor != list_end(&all_list)) {
+      t = list_entry(decay_cursor, struct thread, allelem);
+      decay_cursor = list_next(decay_cursor);
+      if (t != cpu_current ()->idle_thread) {
+        t->recent_cpu = fp_add_int(fp_mul(coef, t->recent_cpu), t->nice);
+        ready_requeue(t, mlfqs_priority(t));
+      }
+
+      /* Let pending interrupts in between threads. */
+      intr_enable();
+      intr_disable();
+    }
+    decay_cursor = NULL;
+    intr_enable();
   }
+}
 
-  struct thread *cur = thread_current();
-  recent_cpu = cur->recent_cpu;
-  nice = cur->nice;
-
-  imsi = (PRI_MAX * (1<<14)) - (recent_cpu / 4);
-  imsi -= (nice * 2 * (1<<14));
-
-  cur->priority = (imsi) / (1<<14);
-  if (cur->priority <= PRI_MIN) cur->priority = PRI_MIN;
-  if (cur->priority >= PRI_MAX) cur->priority = PRI_MAX;
-
-} 
-
 /* Idle thread.  Executes when no other thread is ready to run.
 
    The idle thread is initially put on the ready list by
@@ -547,7 +677,7 @@ static void
 idle (void *idle_started_ UNUSED) 
 {
   struct semaphore *idle_started = idle_started_;
-  idle_thread = thread_current ();
+  cpu_current ()->idle_thread = thread_current ();
   sema_up (idle_started);
 
   for (;;) 
@@ -609,6 +739,8 @@ is_thread (struct thread *t)
 static void
 init_thread (struct thread *t, const char *name, int priority)
 {
+  enum intr_level old_level;
+
   ASSERT (t != NULL);
   ASSERT (PRI_MIN <= priority && priority <= PRI_MAX);
   ASSERT (name != NULL);
@@ -624,6 +756,7 @@ init_thread (struct thread *t, const char *name, int priority)
   t->wake_up = 0;
   t->recent_cpu = 0;
   t->nice = 0;
+  t->state_since = timer_ticks ();
 #ifdef USERPROG
   list_init(&t->child_list);
   t->exit_status = 0;
@@ -645,6 +778,10 @@ init_thread (struct thread *t, const char *name, int priority)
 #endif
 
   t->dir = NULL;
+
+  old_level = intr_disable ();
+  list_push_back (&all_list, &t->allelem);
+  intr_set_level (old_level);
 }
 
 /* Allocates a SIZE-byte frame at the top of thread T's stack and
@@ -668,10 +805,74 @@ alloc_frame (struct thread *t, size_t size)
 static struct thread *
 next_thread_to_run (void) 
 {
-  if (list_empty (&ready_list))
-    return idle_thread;
+  struct thread *t = cpu_current ()->idle_thread;
+
+  spin_lock (&ready_lock);
+  if (ready_bitmap != 0)
+    {
+      t = list_entry (list_front (&ready_queues[ready_max_priority ()]),
+                      struct thread, elem);
+      ready_remove (t);
+    }
+  spin_unlock (&ready_lock);
+  return t;
+}
+
+/* Appends T to the run queue of its current priority. */
+static void
+ready_push (struct thread *t) 
+{
+  ASSERT (PRI_MIN <= t->priority && t->priority <= PRI_MAX);
+  ASSERT (spin_held (&ready_lock));
+
+  list_push_back (&ready_queues[t->priority], &t->elem);
+  ready_bitmap |= (uint64_t) 1 << t->priority;
+  ready_cnt++;
+}
+
+/* Takes T off the run queue it is on. */
+static void
+ready_remove (struct thread *t) 
+{
+  ASSERT (spin_held (&ready_lock));
+
+  list_remove (&t->elem);
+  if (list_empty (&ready_queues[t->priority]))
+    ready_bitmap &= ~((uint64_t) 1 << t->priority);
+  ready_cnt--;
+}
+
+/* Returns the highest priority of any ready thread, or
+   PRI_MIN - 1 if no thread is ready. */
+static int
+ready_max_priority (void) 
+{
+  return priority_bitmap_max (ready_bitmap);
+}
+
+/* Sets T's priority to PRIORITY, moving T to the matching run
+   queue if it is ready.  Threads that keep their priority are
+   left where they are so they do not lose their place. */
+static void
+ready_requeue (struct thread *t, int priority) 
+{
+  enum intr_level old_level;
+
+  if (t->priority == priority)
+    return;
+
+  old_level = intr_disable ();
+  spin_lock (&ready_lock);
+  if (t->status == THREAD_READY) 
+    {
+      ready_remove (t);
+      t->priority = priority;
+      ready_push (t);
+    }
   else
-    return list_entry (list_pop_front (&ready_list), struct thread, elem);
+    t->priority = priority;
+  spin_unlock (&ready_lock);
+  intr_set_level (old_level);
 }
 
 /* Completes a thread switch by activating the new thread's page
@@ -694,14 +895,30 @@ void
 schedule_tail (struct thread *prev) 
 {
   struct thread *curr = running_thread ();
+  int64_t waited;
   
   ASSERT (intr_get_level () == INTR_OFF);
 
   /* Mark us as running. */
   curr->status = THREAD_RUNNING;
 
+  /* Account the time spent on the run queue. */
+  waited = timer_ticks () - curr->state_since;
+  curr->ready_ticks += waited;
+  if (curr->woken)
+    {
+      int bucket = 0;
+      while (waited > 0 && bucket < SCHED_LATENCY_BUCKETS - 1)
+        {
+          waited >>= 1;
+          bucket++;
+        }
+      wakeup_latency[bucket]++;
+      curr->woken = false;
+    }
+
   /* Start new time slice. */
-  thread_ticks = 0;
+  cpu_current ()->thread_ticks = 0;
 
 #ifdef USERPROG
   /* Activate the new address space. */
@@ -731,11 +948,24 @@ static void
 schedule (void) 
 {
   struct thread *curr = running_thread ();
-  struct thread *next = next_thread_to_run ();
+  struct thread *next;
   struct thread *prev = NULL;
 
   ASSERT (intr_get_level () == INTR_OFF);
   ASSERT (curr->status != THREAD_RUNNING);
+
+  next = next_thread_to_run ();
+
+  /* A thread that blocks gives up the CPU by itself; one that is
+     put back on the run queue was preempted or yielded. */
+  if (curr != next && curr != cpu_current ()->idle_thread)
+    {
+      if (curr->status == THREAD_BLOCKED)
+        curr->vol_switches++;
+      else if (curr->status == THREAD_READY)
+        curr->invol_switches++;
+    }
+  curr->state_since = timer_ticks ();
   ASSERT (is_thread (next));
 
   if (curr != next)
@@ -764,33 +994,87 @@ uint32_t thread_stack_ofs = offsetof (struct thread, stack);
 void sleep_thread(int64_t ticks) {
   /*ticks : time that the thread should wake up*/
   struct thread *cur = thread_current();
-  ASSERT(cur != idle_thread);
+  int64_t slot = ticks;
+
+  ASSERT(cur != cpu_current ()->idle_thread);
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  /* A deadline the wheel has already passed goes into the next
+     slot to be scanned, so it expires on the coming tick. */
+  if (slot <= sleep_wheel_now)
+    slot = sleep_wheel_now + 1;
+
   cur->wake_up = ticks;
-  //list_push_back(&sleep_list, &cur->sleep_elem);
-  list_insert_ordered(&sleep_list, &cur->sleep_elem, priority_compare, 0);
+  list_insert_ordered(&sleep_wheel[slot & (SLEEP_WHEEL_SLOTS - 1)],
+                      &cur->sleep_elem, wake_up_less, NULL);
+  if (ticks < next_wake_up) {
+    next_wake_up = ticks;
+    timer_unstretch ();
+  }
   thread_block();
 }
 
+/* Wakes every sleeping thread whose deadline is at or before
+   TICKS.  Costs O(1) when nothing is due.  Otherwise it scans the
+   slots passed since the last call, at most one turn of the wheel,
+   plus one look at each slot head to find the next deadline. */
 void awake_thread(int64_t ticks) {
-
-  struct list_elem *e = list_begin(&sleep_list);
+  int64_t tick;
+  int i;
 
   ASSERT (intr_get_level () == INTR_OFF);
 
-  while (e != list_end(&sleep_list)) {
+  if (ticks < next_wake_up)
+    return;
+
+  tick = sleep_wheel_now + 1;
+  if (ticks - tick >= SLEEP_WHEEL_SLOTS)
+    tick = ticks - SLEEP_WHEEL_SLOTS + 1;
+
+  for (; tick <= ticks; tick++) {
+    struct list *slot = &sleep_wheel[tick & (SLEEP_WHEEL_SLOTS - 1)];
+
+    while (!list_empty(slot)) {
+      struct thread *cur = list_entry(list_front(slot), struct thread, sleep_elem);
 
-    struct thread *cur = list_entry(e, struct thread, sleep_elem);
+      if (cur->wake_up > ticks)
+        break;
 
-    /*awake*/
-    if (cur->wake_up <= ticks) {
+      /*awake*/
       cur->wake_up = 0;
-      list_remove(&cur->sleep_elem);
+      list_pop_front(slot);
       thread_unblock(cur);
     }
-
-    e = list_next(e);
   }
+  sleep_wheel_now = ticks;
+
+  next_wake_up = INT64_MAX;
+  for (i = 0; i < SLEEP_WHEEL_SLOTS; i++)
+    if (!list_empty(&sleep_wheel[i])) {
+      struct thread *t = list_entry(list_front(&sleep_wheel[i]), struct thread, sleep_elem);
+      if (t->wake_up < next_wake_up)
+        next_wake_up = t->wake_up;
+    }
+}
+
+/* Returns the tick at which the scheduler next needs a timer
+   interrupt: the earliest sleep deadline if no thread is waiting
+   for the CPU, or 0 if time slicing has to go on. */
+int64_t
+thread_next_event (void) 
+{
+  ASSERT (intr_get_level () == INTR_OFF);
 
+  return ready_cnt == 0 ? next_wake_up : 0;
+}
+
+/* Orders sleeping threads by wake-up tick, earliest first. */
+static bool
+wake_up_less (const struct list_elem *a, const struct list_elem *b,
+              void *aux UNUSED) 
+{
+  return list_entry (a, struct thread, sleep_elem)->wake_up
+         < list_entry (b, struct thread, sleep_elem)->wake_up;
 }
 
 bool priority_compare (const struct list_elem *a, const struct list_elem *b, void *aux UNUSED){
@@ -803,35 +1087,14 @@ bool priority_compare (const struct list_elem *a, const struct list_elem *b, voi
 
 
 void test_max_priority(void) {
-  if (!list_empty (&ready_list)) {
-    ASSERT(list_begin(&ready_list) != NULL)
-    ASSERT(list_entry (list_begin (&ready_list), struct thread, elem) != NULL)
-
-    if (thread_current ()->priority < list_entry (list_begin (&ready_list), struct thread, elem)->priority){
-      thread_yield ();
-    }
-
-  } 
+  if (thread_current ()->priority < ready_max_priority ())
+    thread_yield ();
 }
 
 void priority_change(struct thread *t, int priority) {
-  t->priority = priority;
-
-  if (t == thread_current() && !list_empty(&ready_list)) {
-
-    struct thread *maximum = list_entry(list_begin(&ready_list), struct thread, elem);
+  ready_requeue (t, priority);
 
-      if (maximum->priority > priority) {
-        thread_yield();
-     }
-  }
-}
-
-struct list_elem *sleep_list_begin() {
-  return list_begin(&sleep_list);
-}
-
-struct list_elem *sleep_list_end() {
-  return list_end(&sleep_list);
+  if (t == thread_current() && ready_max_priority () > priority)
+    thread_yield();
 }
 
@@ -8,6 +8,7 @@
 #include "threads/synch.h"
 #include "filesys/filesys.h"
 #include "filesys/file.h"
+#include "vm/page.h"
 
 
 #ifdef USERPROG
@@ -109,14 +110,26 @@ struct thread
     /* Shared between thread.c and synch.c. */
     struct list_elem elem;              /* List element. */
     struct list_elem sleep_elem;
+    struct list_elem allelem;           /* List element for all threads list. */
     /*for donation */
 
-    struct list lock_list;
-    struct lock *hurdle;
+    struct list lock_list;              /* Locks held. */
+    struct lock *hurdle;                /* Lock waited on. */
+    uint64_t held_map;                  /* Priorities in held_cnt[]. */
+    uint8_t held_cnt[PRI_MAX + 1];      /* Locks held, by priority. */
 
     int nice;
     int recent_cpu;
 
+    /* Scheduler statistics, see thread_print_stats(). */
+    int64_t state_since;                /* Tick of the last status change. */
+    int64_t ready_ticks;                /* Ticks ready but not running. */
+    int64_t blocked_ticks;              /* Ticks blocked. */
+    int vol_switches;                   /* Times it blocked. */
+    int invol_switches;                 /* Times it was preempted. */
+    int donations;                      /* Priority donations received. */
+    bool woken;                         /* Unblocked, not yet run. */
+
     struct dir *dir;
 
 
@@ -139,7 +152,13 @@ struct thread
 
 #endif
 
-    struct hash supt;
+    struct sup_page_table supt;
+    size_t rss;                         /* Frames mapped by this process. */
+    size_t rss_limit;                   /* Most frames it may map, 0: no limit. */
+    size_t locked_cnt;                  /* Pages locked by mmap_populate(). */
+    size_t wss;                         /* Pages used in the last clock cycle. */
+    size_t ws_refs;                     /* Pages used so far in this cycle. */
+    unsigned ws_cycle;                  /* Clock cycle ws_refs belongs to. */
     void *esp;
     struct list mm_list;
     int mm_id;
@@ -159,8 +178,10 @@ extern bool thread_mlfqs;
 void thread_init (void);
 void thread_start (void);
 
-void thread_tick (int64_t);
+void thread_tick (int64_t ticks, int elapsed);
 void thread_print_stats (void);
+struct sched_stats;
+void thread_sched_stats (struct sched_stats *);
 
 typedef void thread_func (void *aux);
 tid_t thread_create (const char *name, int priority, thread_func *, void *);
@@ -175,6 +196,27 @@ const char *thread_name (void);
 void thread_exit (void) NO_RETURN;
 void thread_yield (void);
 
+/* Returns the highest priority whose bit is set in MAP, or
+   PRI_MIN - 1 if MAP is empty.  Scanned as two 32-bit halves so
+   that it stays a pair of `bsr's on i386. */
+static inline int
+priority_bitmap_max (uint64_t map) 
+{
+  uint32_t hi = map >> 32;
+  uint32_t lo = map;
+
+  if (hi != 0)
+    return 63 - __builtin_clz (hi);
+  else if (lo != 0)
+    return 31 - __builtin_clz (lo);
+  else
+    return PRI_MIN - 1;
+}
+
+/* Performs some operation on thread t, given auxiliary data AUX. */
+typedef void thread_action_func (struct thread *t, void *aux);
+void thread_foreach (thread_action_func *, void *);
+
 int thread_get_priority (void);
 void thread_set_priority (int);
 
@@ -184,14 +226,13 @@ int thread_get_recent_cpu (void);
 int thread_get_load_avg (void);
 void thread_calculate_load_avg (void);
 void thread_calculate_recent_cpu (void);
-void increase_recent_cpu(void);
+void increase_recent_cpu(int elapsed);
 void thread_calculate_priority (void);
-struct list_elem *sleep_list_begin(void);
-struct list_elem *sleep_list_end(void);
 
 
 void sleep_thread(int64_t ticks);
 void awake_thread(int64_t ticks); 
+int64_t thread_next_event (void);
 bool priority_compare (const struct list_elem *a, const struct list_elem *b, void *aux);
 void test_max_priority(void);
 void priority_change(struct thread *, int priority);
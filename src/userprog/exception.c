@@ -166,12 +166,16 @@ page_fault (struct intr_frame *f)
   user = (f->error_code & PF_U) != 0;
 
 
-  struct sup_page_table_entry imsi;
-  imsi.user_vaddr = pg_round_down(fault_addr);
+  void *upage = pg_round_down(fault_addr);
 
 //if 문에 write 추가할지?
   if (write) {
     if (!not_present) {
+      /* Writing a page that is still backed by the shared zero
+         frame: give it a private copy. */
+      struct sup_page_table_entry *spte = is_user_vaddr(fault_addr) ? page_lookup(&thread_current()->supt, fault_addr) : NULL;
+      if (spte != NULL && page_copy_on_write(spte))
+        return;
       sys_exit(-1);
     }
   }
@@ -191,17 +195,13 @@ page_fault (struct intr_frame *f)
   if(is_user_vaddr(fault_addr) && not_present){
     //printf("here1\n");
 
-    struct hash_elem *e = hash_find(&thread_current()->supt, &(imsi.hs_elem));
+    struct sup_page_table_entry *spte = page_lookup(&thread_current()->supt, fault_addr);
     //lazy loading 
-    if (e != NULL) {
+    if (spte != NULL) {
       //printf("here2\n");
-      struct sup_page_table_entry *spte = hash_entry(e, struct sup_page_table_entry, hs_elem);
-      if (spte != NULL) {
-      //printf("here3\n");
-        if (load_page(spte)) {
-          //maprintf("here4\n");
-          return;
-        }
+      if (load_page(spte, write)) {
+        //maprintf("here4\n");
+        return;
       }
     }
 
@@ -210,7 +210,7 @@ page_fault (struct intr_frame *f)
             //printf("here5\n");
       if (thread_current()->esp <= fault_addr || fault_addr == f->esp - 32 || fault_addr == f->esp - 4){
             //printf("here6\n");
-        if(stack_growth(&thread_current()->supt, imsi.user_vaddr)){
+        if(stack_growth(&thread_current()->supt, upage, write)){
             //printf("here7\n");
           return;
         }
@@ -0,0 +1,159 @@
+#include "userprog/futex.h"
+#include <debug.h>
+#include <hash.h>
+#include <list.h>
+#include <stdint.h>
+#include "filesys/file.h"
+#include "threads/interrupt.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "vm/page.h"
+
+/* Futexes: sleeping on, and waking sleepers on, a word of user
+   memory.  User code does the uncontended case with atomic
+   instructions alone and only enters the kernel to block or to
+   wake someone.
+
+   Waiters are hashed by a key that names the word independent of
+   who is asking.  A word in a file mapping is named by its file's
+   inode and offset, so processes that map the same file agree on
+   it.  Any other word is private to its address space and is
+   named by that process's page table and the virtual address. */
+
+/* Identifies a futex word. */
+struct futex_key
+  {
+    const void *space;          /* Inode, or supplemental page table. */
+    uintptr_t offset;           /* Byte offset in file, or address. */
+  };
+
+/* A thread sleeping in futex_wait(). */
+struct futex_waiter
+  {
+    struct futex_key key;       /* Word slept on. */
+    struct semaphore sema;      /* Upped by futex_wake(). */
+    struct list_elem elem;      /* Element in a futex_queues[] list. */
+  };
+
+/* Wait queues, hashed by key.  Accessed with interrupts off, which
+   also makes checking the word and queueing on it atomic with
+   respect to futex_wake(). */
+#define FUTEX_QUEUE_CNT 64
+static struct list futex_queues[FUTEX_QUEUE_CNT];
+
+static bool futex_get_key (int *uaddr, struct futex_key *);
+static struct list *futex_queue (const struct futex_key *);
+
+/* Initializes the futex wait queues. */
+void
+futex_init (void)
+{
+  int i;
+
+  for (i = 0; i < FUTEX_QUEUE_CNT; i++)
+    list_init (&futex_queues[i]);
+}
+
+/* If the int at user address UADDR still holds EXPECTED, sleeps
+   until futex_wake() is called on the same word and returns 0.
+   Otherwise returns -1 right away, so a caller that lost a race
+   with the thread that changed the word does not sleep.  Returns
+   -1 also if UADDR is not an aligned, mapped user address. */
+int
+futex_wait (int *uaddr, int expected)
+{
+  struct futex_waiter w;
+  enum intr_level old_level;
+  bool sleep;
+
+  if (!futex_get_key (uaddr, &w.key))
+    return -1;
+  if (!page_pin_range (uaddr, sizeof *uaddr, false))
+    return -1;
+
+  sema_init (&w.sema, 0);
+  old_level = intr_disable ();
+  sleep = *uaddr == expected;
+  if (sleep)
+    list_push_back (futex_queue (&w.key), &w.elem);
+  intr_set_level (old_level);
+  page_unpin_range (uaddr, sizeof *uaddr);
+
+  if (!sleep)
+    return -1;
+  sema_down (&w.sema);
+  return 0;
+}
+
+/* Wakes up to N threads sleeping on the int at user address
+   UADDR, in the order they went to sleep.  Returns the number
+   woken, or -1 if UADDR is not an aligned, mapped user
+   address. */
+int
+futex_wake (int *uaddr, int n)
+{
+  struct futex_key key;
+  struct list *queue;
+  struct list_elem *e, *next;
+  enum intr_level old_level;
+  int woken = 0;
+
+  if (!futex_get_key (uaddr, &key))
+    return -1;
+
+  queue = futex_queue (&key);
+  old_level = intr_disable ();
+  for (e = list_begin (queue); e != list_end (queue) && woken < n; e = next)
+    {
+      struct futex_waiter *w = list_entry (e, struct futex_waiter, elem);
+
+      next = list_next (e);
+      if (w->key.space == key.space && w->key.offset == key.offset)
+        {
+          list_remove (e);
+          sema_up (&w->sema);
+          woken++;
+        }
+    }
+  intr_set_level (old_level);
+
+  return woken;
+}
+
+/* Fills KEY in for the futex word at UADDR in the current
+   process.  Returns false if UADDR is misaligned or not mapped. */
+static bool
+futex_get_key (int *uaddr, struct futex_key *key)
+{
+  struct sup_page_table *supt = &thread_current ()->supt;
+  struct sup_page_table_entry *spte;
+
+  if ((uintptr_t) uaddr % sizeof *uaddr != 0 || !is_user_vaddr (uaddr))
+    return false;
+
+  spte = page_lookup (supt, pg_round_down (uaddr));
+  if (spte == NULL)
+    return false;
+
+  if (spte->type == PAGE_MMAP && spte->file != NULL)
+    {
+      key->space = file_get_inode (spte->file);
+      key->offset = spte->ofs + pg_ofs (uaddr);
+    }
+  else
+    {
+      key->space = supt;
+      key->offset = (uintptr_t) uaddr;
+    }
+  return true;
+}
+
+/* Returns the wait queue KEY hashes to. */
+static struct list *
+futex_queue (const struct futex_key *key)
+{
+  unsigned h = hash_bytes (key, sizeof *key);
+
+  return &futex_queues[h % FUTEX_QUEUE_CNT];
+}
@@ -5,10 +5,15 @@
 #include "threads/init.h"
 #include "threads/pte.h"
 #include "threads/palloc.h"
-#include "vm/frame.h"
 
 static uint32_t *active_pd (void);
 static void invalidate_pagedir (uint32_t *);
+static void invalidate_page (uint32_t *, const void *);
+static void invalidate_range (uint32_t *, const void *, size_t page_cnt);
+
+/* Above this many pages, invalidate_range() flushes the whole TLB
+   instead of invalidating page by page. */
+#define INVLPG_MAX 32
 
 /* Creates a new page directory that has mappings for kernel
    virtual addresses, but none for user virtual addresses.
@@ -25,8 +30,9 @@ pagedir_create (void)
 
 /* This is 2016 spring cs330 skeleton code */
 
-/* Destroys page directory PD, freeing all the pages it
-   references. */
+/* Destroys page directory PD and its page tables.  The user
+   frames it maps belong to the frame table and are released
+   through the supplemental page table instead. */
 void
 pagedir_destroy (uint32_t *pd) 
 {
@@ -40,11 +46,6 @@ pagedir_destroy (uint32_t *pd)
     if (*pde & PTE_P) 
       {
         uint32_t *pt = pde_get_pt (*pde);
-        uint32_t *pte;
-        
-        for (pte = pt; pte < pt + PGSIZE / sizeof *pte; pte++)
-          if (*pte & PTE_P) 
-            free_frame (pte_get_page (*pte));
         palloc_free_page (pt);
       }
   palloc_free_page (pd);
@@ -157,7 +158,50 @@ pagedir_clear_page (uint32_t *pd, void *upage)
   if (pte != NULL && (*pte & PTE_P) != 0)
     {
       *pte &= ~PTE_P;
-      invalidate_pagedir (pd);
+      invalidate_page (pd, upage);
+    }
+}
+
+/* Marks the PAGE_CNT user virtual pages starting at UPAGE "not
+   present" in page directory PD, like pagedir_clear_page(), but
+   invalidates the TLB only once for the whole range. */
+void
+pagedir_clear_range (uint32_t *pd, void *upage, size_t page_cnt) 
+{
+  size_t cleared = 0;
+  size_t i;
+
+  ASSERT (pg_ofs (upage) == 0);
+  ASSERT (is_user_vaddr (upage));
+
+  for (i = 0; i < page_cnt; i++) 
+    {
+      uint32_t *pte = lookup_page (pd, (uint8_t *) upage + i * PGSIZE, false);
+      if (pte != NULL && (*pte & PTE_P) != 0)
+        {
+          *pte &= ~PTE_P;
+          cleared++;
+        }
+    }
+  if (cleared > 0)
+    invalidate_range (pd, upage, page_cnt);
+}
+
+/* Makes the present user virtual page UPAGE in PD read/write if
+   WRITABLE is true, read-only otherwise.  Other bits in the page
+   table entry, including the accessed and dirty bits, are
+   preserved. */
+void
+pagedir_set_writable (uint32_t *pd, const void *upage, bool writable) 
+{
+  uint32_t *pte = lookup_page (pd, upage, false);
+  if (pte != NULL && (*pte & PTE_P) != 0) 
+    {
+      if (writable)
+        *pte |= PTE_W;
+      else 
+        *pte &= ~(uint32_t) PTE_W;
+      invalidate_page (pd, upage);
     }
 }
 
@@ -185,7 +229,7 @@ pagedir_set_dirty (uint32_t *pd, const void *vpage, bool dirty)
       else 
         {
           *pte &= ~(uint32_t) PTE_D;
-          invalidate_pagedir (pd);
+          invalidate_page (pd, vpage);
         }
     }
 }
@@ -214,7 +258,7 @@ pagedir_set_accessed (uint32_t *pd, const void *vpage, bool accessed)
       else 
         {
           *pte &= ~(uint32_t) PTE_A; 
-          invalidate_pagedir (pd);
+          invalidate_page (pd, vpage);
         }
     }
 }
@@ -266,3 +310,30 @@ invalidate_pagedir (uint32_t *pd)
       pagedir_activate (pd);
     } 
 }
+
+/* Invalidates the TLB entry for virtual page VPAGE if PD is the
+   active page directory.  Cheaper than invalidate_pagedir(),
+   which throws away every other translation too.  See [IA32-v2a]
+   "INVLPG--Invalidate TLB Entry". */
+static void
+invalidate_page (uint32_t *pd, const void *vpage) 
+{
+  if (active_pd () == pd) 
+    asm volatile ("invlpg (%0)" : : "r" (vpage) : "memory");
+}
+
+/* Invalidates the TLB entries for the PAGE_CNT virtual pages
+   starting at VPAGE if PD is the active page directory, one page
+   at a time for small ranges and with a single full flush for
+   large ones. */
+static void
+invalidate_range (uint32_t *pd, const void *vpage, size_t page_cnt) 
+{
+  size_t i;
+
+  if (page_cnt > INVLPG_MAX)
+    invalidate_pagedir (pd);
+  else
+    for (i = 0; i < page_cnt; i++)
+      invalidate_page (pd, (const uint8_t *) vpage + i * PGSIZE);
+}
@@ -13,9 +13,11 @@
 #include "filesys/directory.h"
 #include "filesys/file.h"
 #include "filesys/filesys.h"
+#include "filesys/inode.h"
 #include "threads/flags.h"
 #include "threads/init.h"
 #include "threads/interrupt.h"
+#include "threads/malloc.h"
 #include "threads/palloc.h"
 #include "threads/thread.h"
 #include "threads/vaddr.h"
@@ -25,7 +27,16 @@
 #include "vm/page.h"
 #include "vm/swap.h"
 
+/* Passed from process_execute_limited() to start_process(), which
+   must be done with it before it wakes up the parent. */
+struct exec_args
+  {
+    char *file_name;                    /* Command line, in a page. */
+    size_t rss_limit;                   /* Resident-set limit. */
+  };
+
 static thread_func start_process NO_RETURN;
+static thread_func start_fork NO_RETURN;
 static bool load (const char *cmdline, void (**eip) (void), void **esp);
 
 /* Starts a new thread running a user program loaded from
@@ -34,10 +45,20 @@ static bool load (const char *cmdline, void (**eip) (void), void **esp);
    thread id, or TID_ERROR if the thread cannot be created. */
 tid_t
 process_execute (const char *file_name) 
+{
+  return process_execute_limited (file_name, 0);
+}
+
+/* Like process_execute(), but the new process may keep at most
+   RSS_LIMIT pages resident (no limit if 0).  Beyond that it
+   evicts its own pages to make room for new ones. */
+tid_t
+process_execute_limited (const char *file_name, size_t rss_limit) 
 {
   //printf("process execute\n");
   char *fn_copy;
   tid_t tid;
+  struct exec_args args;
   //char *next_ptr;
   char f[256];
   /* Make a copy of FILE_NAME.
@@ -58,14 +79,15 @@ process_execute (const char *file_name)
   //printf("real_file_name : %s\n", real_file_name);
 
   /* Create a new thread to execute FILE_NAME. */
-  tid = thread_create (f, PRI_DEFAULT, start_process, fn_copy); 
-
-  sema_down(&thread_current()->oom_lock);
-
-
+  args.file_name = fn_copy;
+  args.rss_limit = rss_limit;
+  tid = thread_create (f, PRI_DEFAULT, start_process, &args); 
 
-  if (tid == TID_ERROR)
+  if (tid == TID_ERROR) {
     palloc_free_page (fn_copy); 
+    return TID_ERROR;
+  }
+  sema_down(&thread_current()->oom_lock);
 
   struct list_elem *e;
   struct thread *tmp;
@@ -85,9 +107,10 @@ process_execute (const char *file_name)
 /* A thread function that loads a user process and makes it start
    running. */
 static void
-start_process (void *f_name)
+start_process (void *args_)
 {
-  char *file_name = f_name;
+  struct exec_args *args = args_;
+  char *file_name = args->file_name;
   struct intr_frame if_;
   bool success;
 
@@ -120,6 +143,7 @@ start_process (void *f_name)
   if_.gs = if_.fs = if_.es = if_.ds = if_.ss = SEL_UDSEG;
   if_.cs = SEL_UCSEG;
   if_.eflags = FLAG_IF | FLAG_MBS;
+  thread_current ()->rss_limit = args->rss_limit;
   success = load (file_name, &if_.eip, &if_.esp);
 
   //printf("here\n");
@@ -152,6 +176,146 @@ start_process (void *f_name)
   NOT_REACHED ();
 }
 
+/* Starts a child thread that continues from the parent's system
+   call frame F with a copy-on-write duplicate of the parent's
+   address space.  Returns the child's thread id to the parent, or
+   -1 if the child could not be set up. */
+tid_t
+process_fork (struct intr_frame *f)
+{
+  struct intr_frame if_ = *f;
+  struct list_elem *e;
+  struct thread *tmp;
+  tid_t tid;
+
+  tid = thread_create (thread_current ()->name, thread_get_priority (),
+                       start_fork, &if_);
+  if (tid == TID_ERROR)
+    return TID_ERROR;
+  sema_down (&thread_current ()->oom_lock);
+
+  for (e = list_begin (&thread_current ()->child_list);
+       e != list_end (&thread_current ()->child_list); e = list_next (e))
+    {
+      tmp = list_entry (e, struct thread, child_elem);
+      if (tmp->tid == tid && tmp->flag == 1)
+        return process_wait (tid);
+    }
+  return tid;
+}
+
+#ifdef VM
+/* Gives the running thread its own copy of each of PARENT's file
+   mappings, on its own reopened file.  Its pages start out not
+   loaded; faulting one in finds the parent's frame for it if it is
+   resident, so both processes share the mapped data. */
+static bool
+fork_mmaps (struct thread *parent)
+{
+  struct thread *curr = thread_current ();
+  struct list_elem *e;
+
+  for (e = list_begin (&parent->mm_list); e != list_end (&parent->mm_list);
+       e = list_next (e))
+    {
+      struct mmap_entry *pmm = list_entry (e, struct mmap_entry, mm_elem);
+      struct mmap_entry *mm = malloc (sizeof (struct mmap_entry));
+      int i;
+
+      if (mm == NULL)
+        return false;
+      rwlock_write_acquire (&sys_lock);
+      mm->file = file_reopen (pmm->file);
+      rwlock_write_release (&sys_lock);
+      if (mm->file == NULL)
+        {
+          free (mm);
+          return false;
+        }
+      mm->mm_id = pmm->mm_id;
+      mm->mm_addr = pmm->mm_addr;
+      mm->size = 0;
+      list_push_back (&curr->mm_list, &mm->mm_elem);
+
+      for (i = 0; i < pmm->size; i += PGSIZE)
+        {
+          struct sup_page_table_entry *pspte, *spte;
+
+          pspte = page_lookup (&parent->supt, pmm->mm_addr + i);
+          spte = allocate_page (&curr->supt, pspte->user_vaddr);
+          if (spte == NULL)
+            return false;
+          spte->location = ON_MMAP;
+          spte->type = PAGE_MMAP;
+          spte->file = mm->file;
+          spte->ofs = pspte->ofs;
+          spte->read_bytes = pspte->read_bytes;
+          spte->zero_bytes = pspte->zero_bytes;
+          spte->advice = pspte->advice;
+          spte->pinned = false;
+          mm->size = i + PGSIZE < pmm->size ? i + PGSIZE : pmm->size;
+        }
+    }
+  curr->mm_id = parent->mm_id;
+  return true;
+}
+#endif
+
+/* A thread function that turns a new thread into a copy of its
+   parent process, returning 0 from the parent's fork() call. */
+static void
+start_fork (void *parent_if)
+{
+  struct thread *curr = thread_current ();
+  struct thread *parent = curr->parent;
+  struct intr_frame if_ = *(struct intr_frame *) parent_if;
+  bool success = false;
+  int i;
+
+  curr->pagedir = pagedir_create ();
+  curr->rss_limit = parent->rss_limit;
+#ifdef VM
+  if (!page_init (&curr->supt))
+    goto done;
+#endif
+  if (curr->pagedir == NULL)
+    goto done;
+  process_activate ();
+
+#ifdef VM
+  if (!page_fork (parent) || !fork_mmaps (parent))
+    goto done;
+#endif
+
+  rwlock_write_acquire (&sys_lock);
+  for (i = 3; i < 200; i++)
+    {
+      if (parent->fds[i] == NULL)
+        continue;
+      curr->fds[i] = file_reopen (parent->fds[i]);
+      if (curr->fds[i] == NULL)
+        break;
+      file_seek (curr->fds[i], file_tell (parent->fds[i]));
+      if (parent->fds_dir[i] != NULL)
+        curr->fds_dir[i] = dir_open (inode_reopen (dir_get_inode (parent->fds_dir[i])));
+    }
+  rwlock_write_release (&sys_lock);
+  success = i == 200;
+
+ done:
+  curr->esp = if_.esp;
+  if_.eax = 0;
+
+  sema_up (&parent->oom_lock);
+  if (!success)
+    {
+      curr->flag = 1;
+      sys_exit (-1);
+    }
+  asm volatile ("movl %0, %%esp; jmp intr_exit" : : "g" (&if_) : "memory");
+  NOT_REACHED ();
+}
+
 /* This is 2016 spring cs330 skeleton code */
 
 /* Waits for thread TID to die and returns its exit status.  If
@@ -218,14 +382,17 @@ process_exit (void)
          that's been freed (and cleared). */
       curr->pagedir = NULL;
       pagedir_activate (NULL);
-      pagedir_destroy (pd);
     }
+#ifdef VM
+  /* Release frames and swap slots through the supplemental page
+     table; frames may be shared with other processes. */
+  destroy_supt (&thread_current ()->supt);
+#endif
+  if (pd != NULL)
+    pagedir_destroy (pd);
   sema_up(&thread_current()->child_lock);
 
   sema_down(&thread_current()->sync_lock);
-#ifdef VM
-  destroy_supt (&thread_current ()->supt, NULL);
-#endif
   dir_close(thread_current()->dir);
 
   //free_all_page(curr);
@@ -336,7 +503,8 @@ load (const char *file_name, void (**eip) (void), void **esp)
   /* Allocate and activate page directory. */
   t->pagedir = pagedir_create ();
 #ifdef VM
-  page_init(&t->supt);
+  if (!page_init(&t->supt))
+    goto done;
 #endif
 
   if (t->pagedir == NULL) 
@@ -534,6 +702,7 @@ load_segment (struct file *file, off_t ofs, uint8_t *upage,
          We will read PAGE_READ_BYTES bytes from FILE
          and zero the final PAGE_ZERO_BYTES bytes. */
       spte->location = ON_FILESYS;
+      spte->type = PAGE_FILE;
       spte->file = file;
       spte->ofs = ofs;
       spte->read_bytes =page_read_bytes;
@@ -591,8 +760,10 @@ setup_stack (void **esp)
   if (kpage != NULL) 
     {
       success = install_page (((uint8_t *) PHYS_BASE) - PGSIZE, kpage, true);
-      if (success)
+      if (success) {
         *esp = PHYS_BASE;
+        spte->pinned = false;
+      }
       else
        free_frame (kpage);
     }
@@ -673,19 +844,15 @@ struct sup_page_table_entry* check_address(void *address){
     return NULL;
   }
 
-  struct sup_page_table_entry imsi;  
-  imsi.user_vaddr = pg_round_down(address); 
-  struct hash_elem *e = hash_find(&thread_current()->supt, &(imsi.hs_elem));  
+  struct sup_page_table_entry *spte = page_lookup(&thread_current()->supt, address);  
 
-  if (e != NULL) {  
-    struct sup_page_table_entry *spte = hash_entry(e, struct sup_page_table_entry, hs_elem);  
-    if (load_page(spte)) return spte;   
+  if (spte != NULL) {  
+    if (load_page(spte, false)) return spte;   
   } 
 
    if (thread_current()->esp - 32 <= address && PHYS_BASE - STACK_MAX_SIZE <=address) { 
-    if(stack_growth(&thread_current()->supt, pg_round_down(address))){  
-      struct hash_elem *e = hash_find(&thread_current()->supt, &(imsi.hs_elem));  
-      if (e != NULL) return hash_entry(e, struct sup_page_table_entry, hs_elem);  
+    if(stack_growth(&thread_current()->supt, pg_round_down(address), false)){  
+      return page_lookup(&thread_current()->supt, address);  
     } 
   }   
   return NULL;
@@ -1,10 +1,13 @@
 #ifndef USERPROG_PROCESS_H
 #define USERPROG_PROCESS_H
 
+#include "threads/interrupt.h"
 #include "threads/thread.h"
 #include "vm/page.h"
 
 tid_t process_execute (const char *file_name);
+tid_t process_execute_limited (const char *file_name, size_t rss_limit);
+tid_t process_fork (struct intr_frame *f);
 int process_wait (tid_t);
 void process_exit (void);
 void process_activate (void);
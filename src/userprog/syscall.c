@@ -1,6 +1,7 @@
 #include "userprog/syscall.h"
 #include <stdio.h>
 #include <syscall-nr.h>
+#include <sched-stats.h>
 #include "threads/interrupt.h"
 #include "threads/thread.h"
 #include "threads/init.h"
@@ -13,12 +14,14 @@
 #include "pagedir.h"
 #include "threads/vaddr.h"
 #include <string.h>
+#include <round.h>
 #include "filesys/inode.h"
 #include "filesys/directory.h"
 #include "threads/palloc.h"
 #include "lib/kernel/list.h"
 #include "vm/frame.h"
 #include "vm/page.h"
+#include "userprog/futex.h"
 #include "filesys/directory.h"
 #include "filesys/inode.h"
 #include "filesys/filesys.h"
@@ -27,7 +30,9 @@ static void syscall_handler (struct intr_frame *);
 void
 syscall_init (void) 
 {
-	lock_init(&sys_lock);
+	rwlock_init(&sys_lock);
+	lock_set_name(&sys_lock.lock, "sys");
+	futex_init();
 	intr_register_int (0x30, 3, INTR_ON, syscall_handler, "syscall");
 }
 
@@ -116,7 +121,11 @@ syscall_handler (struct intr_frame *f)
 			void *buffer = (void *) *((uint32_t *)(f->esp+8));	
 			unsigned size = (unsigned) *((uint32_t *)(f->esp+12));	
 
+			/* Keep the buffer resident while the file system fills it. */
+			if (!page_pin_range(buffer, size, true))
+				sys_exit(-1);
 			f->eax = sys_read(fd, buffer, size);
+			page_unpin_range(buffer, size);
 			break;
 		}
 
@@ -134,7 +143,10 @@ syscall_handler (struct intr_frame *f)
 			buffer = (void *) *((uint32_t *)(f->esp+8));
 			size = (unsigned)*((uint32_t *)(f->esp+12));
 
+			if (!page_pin_range(buffer, size, false))
+				sys_exit(-1);
 			f->eax = sys_write(fd, buffer, size);
+			page_unpin_range(buffer, size);
 			break;
 		}
 		case SYS_SEEK:
@@ -222,6 +234,84 @@ syscall_handler (struct intr_frame *f)
 			break;
 		}
 
+		case SYS_FORK:
+		{
+			f->eax = sys_fork(f);
+			break;
+		}
+
+		case SYS_MMAP_POPULATE:
+		{
+			check_address(f->esp+4);
+			check_address(f->esp+8);
+			check_address(f->esp+12);
+			int fd = (int) *((uint32_t *)(f->esp+4));
+			void *addr = (void *) *((uint32_t *)(f->esp+8));
+			bool lock = (bool) *((uint32_t *)(f->esp+12));
+			f->eax = sys_mmap_populate(fd, addr, lock);
+			break;
+		}
+
+		case SYS_EXEC_LIMITED:
+		{
+			check_address(f->esp+4);
+			check_address(f->esp+8);
+			char *cmd_line = (char *) *((uint32_t *)(f->esp+4));
+			size_t max_pages = (size_t) *((uint32_t *)(f->esp+8));
+			f->eax = sys_exec_limited(cmd_line, max_pages);
+			break;
+		}
+
+		case SYS_MSYNC:
+		{
+			check_address(f->esp+4);
+			check_address(f->esp+8);
+			void *addr = (void *) *((uint32_t *)(f->esp+4));
+			size_t length = (size_t) *((uint32_t *)(f->esp+8));
+			f->eax = sys_msync(addr, length);
+			break;
+		}
+
+		case SYS_MADVISE:
+		{
+			check_address(f->esp+4);
+			check_address(f->esp+8);
+			check_address(f->esp+12);
+			void *addr = (void *) *((uint32_t *)(f->esp+4));
+			size_t length = (size_t) *((uint32_t *)(f->esp+8));
+			int advice = (int) *((uint32_t *)(f->esp+12));
+			f->eax = sys_madvise(addr, length, advice);
+			break;
+		}
+
+		case SYS_FUTEX_WAIT:
+		{
+			check_address(f->esp+4);
+			check_address(f->esp+8);
+			int *uaddr = (int *) *((uint32_t *)(f->esp+4));
+			int expected = (int) *((uint32_t *)(f->esp+8));
+			f->eax = futex_wait(uaddr, expected);
+			break;
+		}
+
+		case SYS_FUTEX_WAKE:
+		{
+			check_address(f->esp+4);
+			check_address(f->esp+8);
+			int *uaddr = (int *) *((uint32_t *)(f->esp+4));
+			int n = (int) *((uint32_t *)(f->esp+8));
+			f->eax = futex_wake(uaddr, n);
+			break;
+		}
+
+		case SYS_SCHED_STATS:
+		{
+			check_address(f->esp+4);
+			struct sched_stats *stats = (struct sched_stats *) *((uint32_t *)(f->esp+4));
+			f->eax = sys_sched_stats(stats);
+			break;
+		}
+
 	}
 	//printf("%d : system number, %p : esp pointer\n", n, (f->esp) );
   //printf ("system call!\n");
@@ -258,9 +348,9 @@ int sys_write (int fd, const void *buffer, unsigned size) {
 		}
 
 		else {
-			lock_acquire(&sys_lock);
+			rwlock_write_acquire(&sys_lock);
 			val = file_write(file_for_write, (char *)buffer, size);
-			lock_release(&sys_lock);
+			rwlock_write_release(&sys_lock);
 
 		}
 	}
@@ -275,6 +365,11 @@ int sys_exec(char *cmd_line){
 
 
 
+int sys_exec_limited(char *cmd_line, size_t max_pages){
+	check_address(cmd_line);
+	return process_execute_limited(cmd_line, max_pages);
+}
+
 int sys_wait(pid_t pid){
 	return process_wait(pid);
 }
@@ -308,11 +403,11 @@ int sys_remove (const char *file) {
 int sys_open (const char *file) {
 	//printf("open\n");
 	if (file == NULL) return -1;
-	lock_acquire(&sys_lock);
+	rwlock_read_acquire(&sys_lock);
 
 	struct file *open_file = filesys_open(file);
 
-	lock_release(&sys_lock);
+	rwlock_read_release(&sys_lock);
 	
 	if (open_file == NULL) {
 		return -1;
@@ -382,9 +477,9 @@ int sys_read(int fd, void *buffer, unsigned size) {
 			val = -1;
 		}
 		else {
-			lock_acquire(&sys_lock);
+			rwlock_read_acquire(&sys_lock);
 			val = file_read(file_for_read, buffer, size);
-			lock_release(&sys_lock);
+			rwlock_read_release(&sys_lock);
 
 		}
 	}
@@ -419,13 +514,13 @@ void sys_close(int fd){
 
 mapid_t sys_mmap(int fd, void *addr) {
 
-	lock_acquire(&sys_lock);
+	rwlock_write_acquire(&sys_lock);
 	struct file *file = thread_current()->fds[fd];
 	if (inode_is_dir(file_get_inode(file)) == true)
 		return -1;
 	file = file_reopen(file);
 	uint32_t read_bytes = file_length(file);
-	lock_release(&sys_lock);
+	rwlock_write_release(&sys_lock);
 	off_t ofs = 0;
 
 	if(pg_ofs(addr) != 0) return -1;
@@ -450,6 +545,7 @@ mapid_t sys_mmap(int fd, void *addr) {
 		}
 #ifdef VM
 		spte->location = ON_MMAP;
+		spte->type = PAGE_MMAP;
 		spte->file = file;
 		spte->ofs = ofs;
 		spte->read_bytes =page_read_bytes;
@@ -473,9 +569,8 @@ mapid_t sys_mmap(int fd, void *addr) {
 
 void sys_munmap(mapid_t mapping) {
 	struct list_elem *e;
-	off_t ofs = 0;
 	struct mmap_entry *mm = NULL;
-	lock_acquire(&sys_lock);
+	rwlock_write_acquire(&sys_lock);
 	for(e = list_begin(&thread_current()->mm_list); e != list_end(&thread_current()->mm_list); e = list_next(e)){
 		if(list_entry(e, struct mmap_entry, mm_elem)->mm_id == mapping) {
 			mm = list_entry(e, struct mmap_entry, mm_elem);
@@ -484,43 +579,85 @@ void sys_munmap(mapid_t mapping) {
 		}
 	}
 	if (mm == NULL) {
-		lock_release(&sys_lock);
+		rwlock_write_release(&sys_lock);
 		return;
 	}
 
 	//mm is not null
 
-	int i = mm->size;
-	for (i=mm->size; i>0; i -= PGSIZE) {
-		struct sup_page_table_entry imsi;
-		imsi.user_vaddr = pg_round_down(mm->mm_addr);
-		struct hash_elem *e = hash_find(&thread_current()->supt, &(imsi.hs_elem));
-		struct sup_page_table_entry *spte = hash_entry(e, struct sup_page_table_entry, hs_elem);
-
-		if(spte->location == ON_FRAME) {
-			if(pagedir_is_dirty(thread_current()->pagedir, spte->user_vaddr)) {
-				file_seek(mm->file, ofs);
-				file_write(mm->file, spte->user_vaddr, spte->read_bytes);
-			}
-			pagedir_clear_page(thread_current()->pagedir, spte->user_vaddr);
-			find_and_free_frame(spte);
+	int i;
+	for (i=0; i<mm->size; i += PGSIZE) {
+		struct sup_page_table_entry *spte = page_lookup(&thread_current()->supt, mm->mm_addr + i);
 
-		}
+		/* From the frame, not the user address, so that writing
+		   back cannot fault and need the file system again. */
+		frame_writeback(spte);
+	}
+
+	/* Unmap the whole region with a single TLB invalidation. */
+	pagedir_clear_range(thread_current()->pagedir, mm->mm_addr, DIV_ROUND_UP(mm->size, PGSIZE));
 
-		hash_delete(&thread_current()->supt, &spte->hs_elem);
-		free(spte);
+	for (i=0; i<mm->size; i += PGSIZE) {
+		struct sup_page_table_entry *spte = page_lookup(&thread_current()->supt, mm->mm_addr + i);
 
-		ofs+= PGSIZE;
-		mm->mm_addr += PGSIZE;
+		free_page(&thread_current()->supt, spte);
 	}
 
 	file_close(mm->file);
 	free(mm);
-	lock_release(&sys_lock);
+	rwlock_write_release(&sys_lock);
+}
+
+pid_t sys_fork(struct intr_frame *f) {
+	return process_fork(f);
+}
+
+/*
+ * Like sys_mmap, but read the whole file in right away instead of
+ * page by page on fault.  With LOCK the pages are never evicted, and
+ * the call fails if they cannot all be made resident.
+ */
+mapid_t sys_mmap_populate(int fd, void *addr, bool lock) {
+	mapid_t mapping = sys_mmap(fd, addr);
+	struct list_elem *e;
+	struct mmap_entry *mm = NULL;
+
+	if (mapping == -1) return -1;
+	for(e = list_begin(&thread_current()->mm_list); e != list_end(&thread_current()->mm_list); e = list_next(e)){
+		if(list_entry(e, struct mmap_entry, mm_elem)->mm_id == mapping) {
+			mm = list_entry(e, struct mmap_entry, mm_elem);
+			break;
+		}
+	}
+	if (!page_populate(&thread_current()->supt, mm->mm_addr, mm->size, lock) && lock) {
+		sys_munmap(mapping);
+		return -1;
+	}
+	return mapping;
+}
+
+int sys_msync(void *addr, size_t length) {
+	if (pg_ofs(addr) != 0 || !is_user_vaddr(addr)) return -1;
+	return page_sync(&thread_current()->supt, addr, length) ? 0 : -1;
+}
+
+int sys_madvise(void *addr, size_t length, int advice) {
+	if (pg_ofs(addr) != 0 || !is_user_vaddr(addr)) return -1;
+	return page_advise(&thread_current()->supt, addr, length, advice) ? 0 : -1;
+}
+
+int sys_sched_stats(struct sched_stats *stats) {
+	if (!page_pin_range(stats, sizeof *stats, true))
+		sys_exit(-1);
+	thread_sched_stats(stats);
+	stats->rss = thread_current()->rss;
+	stats->wss = frame_wss(thread_current());
+	page_unpin_range(stats, sizeof *stats);
+	return 0;
 }
 
 int sys_chdir (const char *dir) {
-  lock_acquire(&sys_lock);
+  rwlock_write_acquire(&sys_lock);
 
   char path[strlen(dir) + 1];
   memcpy(path, dir, strlen(dir)+1);
@@ -530,7 +667,7 @@ int sys_chdir (const char *dir) {
 
   if(next_dir == NULL)
   {
-    lock_release(&sys_lock);
+    rwlock_write_release(&sys_lock);
     return 0;
   }
   else {
@@ -540,7 +677,7 @@ int sys_chdir (const char *dir) {
 
 
   	thread_current()->dir = next_dir;
-  	lock_release(&sys_lock);
+  	rwlock_write_release(&sys_lock);
   	return 1;
   }
 }
@@ -553,9 +690,9 @@ int sys_mkdir (const char *dir) {
   else {
   	palloc_free_page(p);
   }
-  lock_acquire (&sys_lock);
+  rwlock_write_acquire(&sys_lock);
   bool ret = filesys_create(dir, 0, true);
-  lock_release (&sys_lock);
+  rwlock_write_release(&sys_lock);
   return (int) ret;
 }
 
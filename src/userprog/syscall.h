@@ -1,15 +1,19 @@
 #ifndef USERPROG_SYSCALL_H
 #define USERPROG_SYSCALL_H
+#include <stdbool.h>
+#include <stddef.h>
 #define mapid_t int
 
-struct lock sys_lock;
+struct rwlock sys_lock;
 
 typedef int pid_t;
+struct intr_frame;
 void syscall_init (void);
 void sys_exit(int status);
 int sys_write (int fd, const void *buffer, unsigned size);
 int sys_wait(pid_t pid);
 int sys_exec(char *cmd_line);
+int sys_exec_limited(char *cmd_line, size_t max_pages);
 int sys_create(const char *file, unsigned initial_size);
 int sys_remove (const char *file);
 int sys_open (const char *file);
@@ -20,12 +24,18 @@ void sys_seek(int fd, unsigned position);
 unsigned sys_tell (int fd);
 void sys_close(int fd );
 mapid_t sys_mmap(int fd, void *addr);
+mapid_t sys_mmap_populate(int fd, void *addr, bool lock);
 void sys_munmap(mapid_t mapping);
 int sys_chdir (const char *dir);
 int sys_mkdir (const char *dir);
 int sys_readdir (int fd, char *name);
 int sys_isdir (int fd);
 int sys_inumber (int fd);
+pid_t sys_fork(struct intr_frame *f);
+int sys_msync(void *addr, size_t length);
+int sys_madvise(void *addr, size_t length, int advice);
+struct sched_stats;
+int sys_sched_stats(struct sched_stats *stats);
 
 
 #endif /* userprog/syscall.h */
@@ -5,14 +5,64 @@
 #include "threads/synch.h"
 #include "threads/thread.h"
 #include "threads/palloc.h"
+#include "threads/vaddr.h"
 #include "userprog/pagedir.h"
+#include "userprog/syscall.h"
+#include "filesys/file.h"
+#include <hash.h>
 #include <list.h>
 #include <stdio.h>
+#include <string.h>
 
 
 struct list frame_table;
 struct lock frame_lock;
 struct list_elem *clock_elem; 
+
+/* Signaled under frame_lock when page_out() is done with its pages. */
+static struct condition transit_done;
+
+/* Number of frames in frame_table. */
+static size_t frame_cnt;
+
+/* Completed revolutions of the clock hand, for working-set sampling. */
+static unsigned clock_cycle;
+
+/* Page of zeros mapped read-only for untouched all-zero pages.
+   Taken from the kernel pool so it never enters the frame table. */
+static void *zero_frame;
+
+/* Frames of file pages shared between processes: read-only
+   executable pages by every process running the same program, and
+   file-mapping pages by every process mapping the same file, so that
+   a store through one mapping is seen through all of them.  Keyed by
+   (inode, offset, read_bytes, mmap): segments that map the same
+   offset but stop reading at different points differ in their
+   zero-filled tail, and a writable mapping of an executable must not
+   write into its code pages. */
+static struct hash share_table;
+
+/* Page reclaim daemon. */
+static struct semaphore reclaim_sema;
+static bool reclaim_started;
+static bool reclaim_pending;            /* reclaim_sema already upped. */
+static size_t reclaim_low, reclaim_high;
+
+static struct frame_table_entry *get_frame (enum palloc_flags flag, struct thread *t);
+static void attach_page (struct frame_table_entry *fte, struct sup_page_table_entry *spte);
+static void detach_page (struct sup_page_table_entry *spte);
+static void destroy_frame (struct frame_table_entry *fte);
+static void remove_frame_entry (struct frame_table_entry *fte);
+static bool frame_is_evictable (struct frame_table_entry *fte);
+static bool frame_test_and_clear_accessed (struct frame_table_entry *fte);
+static bool frame_test_and_clear_dirty (struct frame_table_entry *fte);
+static void page_out (struct frame_table_entry *fte, bool fs_locked);
+static unsigned share_hash (const struct hash_elem *e, void *aux UNUSED);
+static bool share_less (const struct hash_elem *a, const struct hash_elem *b, void *aux UNUSED);
+static size_t free_frame_cnt (void);
+static void reclaim_daemon (void *aux UNUSED);
+static void roll_wss (struct thread *t);
+static bool frame_owned_by (struct frame_table_entry *fte, struct thread *t);
 /*
  * Initialize frame table
  */
@@ -21,44 +71,162 @@ frame_init (void)
 {
 	list_init(&frame_table);
 	lock_init(&frame_lock);
+	lock_set_name(&frame_lock, "frame");
+	cond_init(&transit_done);
 	clock_elem = NULL;
+	frame_cnt = 0;
+	hash_init(&share_table, share_hash, share_less, NULL);
+	zero_frame = palloc_get_page(PAL_ASSERT | PAL_ZERO);
+	reclaim_started = false;
 }
 
+/* Returns the kernel address of the shared zero frame. */
+void *
+frame_zero_page (void)
+{
+	return zero_frame;
+}
 
-/* 
- * Make a new frame table entry for addr.
+/*
+ * Start the page reclaim daemon.  Needs the swap device, so this is
+ * called after swap_init().
  */
-void *
-allocate_frame (enum palloc_flags flag, struct sup_page_table_entry *spte)
+void
+frame_reclaim_init (void)
 {
-	lock_acquire(&frame_lock);
-	//printf("frame allocation started\n");
-	void *frame = palloc_get_page(flag);
-	if (frame == NULL) {
-		if(!evict_frame()) {
+	size_t user_pages = palloc_user_page_cnt();
+
+	reclaim_low = user_pages * RECLAIM_LOW_WATERMARK / 64;
+	reclaim_high = user_pages * RECLAIM_HIGH_WATERMARK / 64;
+	if (reclaim_low == 0)
+		return;
+
+	sema_init(&reclaim_sema, 0);
+	reclaim_pending = false;
+	reclaim_started = thread_create("reclaimd", PRI_DEFAULT, reclaim_daemon, NULL) != TID_ERROR;
+}
+
+/* Number of user pool frames that are not in the frame table. */
+static size_t free_frame_cnt (void) {
+	size_t user_pages = palloc_user_page_cnt();
+	return frame_cnt < user_pages ? user_pages - frame_cnt : 0;
+}
+
+/*
+ * Evict frames in the background, one per frame_lock hold, whenever
+ * free user frames fall below the low watermark, until the high
+ * watermark is restored.  This keeps page faults from paying for
+ * eviction and swap-out themselves in the common case.
+ */
+static void reclaim_daemon (void *aux UNUSED) {
+	for (;;) {
+		sema_down(&reclaim_sema);
+		for (;;) {
+			bool evicted;
+
+			lock_acquire(&frame_lock);
+			evicted = free_frame_cnt() < reclaim_high && evict_frame(NULL);
+			/* Cleared in the same hold as the last check, so a
+			   get_frame() that finds the pool low afterwards wakes
+			   us again. */
+			if (!evicted)
+				reclaim_pending = false;
 			lock_release(&frame_lock);
-			return NULL;
+			if (!evicted)
+				break;
 		}
+	}
+}
+
+
+/*
+ * Take a frame from the user pool, evicting one if it is empty, and
+ * add an entry for it to the frame table.  Called with frame_lock held.
+ */
+static struct frame_table_entry *
+get_frame (enum palloc_flags flag, struct thread *t)
+{
+	void *frame;
+
+	/*
+	 * A process at its resident-set limit replaces its own pages.  The
+	 * limit is soft: if all of them are pinned, locked or shared, the
+	 * frame is taken anyway rather than failing the fault.
+	 */
+	if (t->rss_limit != 0 && t->rss >= t->rss_limit)
+		evict_frame(t);
+
+	frame = palloc_get_page(flag);
+	if (frame == NULL) {
+		if(!evict_frame(NULL))
+			return NULL;
 		frame = palloc_get_page(flag | PAL_USER);
+		if (frame == NULL)
+			return NULL;
 	}
 
 	// make a fte corresponding to palloced frame
 	struct frame_table_entry *fte = malloc(sizeof(struct frame_table_entry));
-	if (fte == NULL) return NULL;
+	if (fte == NULL) {
+		palloc_free_page(frame);
+		return NULL;
+	}
 
-	//put info into fte
-	spte->accessed = true;
 	fte->frame = frame;
-	fte->owner = thread_current();
-	fte->spte = spte;
+	list_init(&fte->sptes);
+	fte->inode = NULL;
+	fte->ofs = 0;
+	fte->read_bytes = 0;
+	fte->mmap = false;
+	fte->age = FRAME_AGE_MSB;
 	list_push_back(&frame_table, &fte->ft_elem);
+	frame_cnt++;
+
+	if (reclaim_started && !reclaim_pending && free_frame_cnt() < reclaim_low) {
+		reclaim_pending = true;
+		sema_up(&reclaim_sema);
+	}
+	return fte;
+}
+
+/*
+ * Tell whether a frame can be taken for a page nobody has asked for
+ * yet without dropping below the reclaim low watermark.
+ */
+bool frame_can_prefetch(void) {
+	return free_frame_cnt() > reclaim_low;
+}
+
+/* 
+ * Make a new frame table entry for addr.
+ */
+void *
+allocate_frame (enum palloc_flags flag, struct sup_page_table_entry *spte)
+{
+	struct frame_table_entry *fte;
+
+	lock_acquire(&frame_lock);
+	//printf("frame allocation started\n");
+	fte = get_frame(flag, spte->owner);
+	if (fte == NULL) {
+		lock_release(&frame_lock);
+		return NULL;
+	}
+
+	//put info into fte
+	spte->pinned = true;
+	attach_page(fte, spte);
 
 	//printf("frame allocation finished with user address %p\n", spte->user_vaddr);
 	lock_release(&frame_lock);
 	//printf("kpage : %p\n", frame);
-	return frame;
+	return fte->frame;
 }
 
+/*
+ * Free the frame at KPAGE regardless of who maps it.  Only meant for
+ * frames that were just allocated and never published.
+ */
 void free_frame(uint8_t *kpage) {
 	lock_acquire(&frame_lock);
 	//printf("frame free started");
@@ -77,9 +245,9 @@ void free_frame(uint8_t *kpage) {
 	}
 	//printf("frame free started with %p\n", fte->spte);
 
-	palloc_free_page(fte->frame);
-	list_remove(&fte->ft_elem);
-	free(fte);
+	while (!list_empty(&fte->sptes))
+		detach_page(list_entry(list_front(&fte->sptes), struct sup_page_table_entry, fte_elem));
+	destroy_frame(fte);
 	//printf("frame free finished\n");
 
 	lock_release(&frame_lock);
@@ -91,32 +259,341 @@ void print_all_frame() {
 		//printf("%p : current list entry\n", list_entry(e, struct frame_table_entry, ft_elem)->spte->user_vaddr);
 	}
 }
-void find_and_free_frame(struct sup_page_table_entry *spte) {
+
+/*
+ * Drop SPTE's reference to its frame.  The frame itself is freed
+ * once no page maps it any more.
+ */
+void frame_release(struct sup_page_table_entry *spte) {
+	struct frame_table_entry *fte;
+
+	lock_acquire(&frame_lock);
+	fte = spte->fte;
+	if (fte != NULL) {
+		detach_page(spte);
+		if (list_empty(&fte->sptes))
+			destroy_frame(fte);
+	}
+	lock_release(&frame_lock);
+}
+
+/*
+ * Look for a resident shared copy of SPTE's file page.  If
+ * there is one, SPTE is attached to it and pinned until it has been
+ * mapped, and its kernel address is returned.  Otherwise NULL.
+ */
+void *frame_share_get(struct sup_page_table_entry *spte) {
+	struct frame_table_entry key;
+	struct hash_elem *e;
 	struct frame_table_entry *fte = NULL;
-	struct list_elem *e;
-	for (e=list_begin(&frame_table); e!=list_end(&frame_table); e=list_next(e)) {
-		if (list_entry(e, struct frame_table_entry, ft_elem)->spte == spte) {
-			fte = list_entry(e, struct frame_table_entry, ft_elem);
-			break;
-		}
+
+	key.inode = file_get_inode(spte->file);
+	key.ofs = spte->ofs;
+	key.read_bytes = spte->read_bytes;
+	key.mmap = spte->type == PAGE_MMAP;
+
+	lock_acquire(&frame_lock);
+	e = hash_find(&share_table, &key.share_elem);
+	if (e != NULL) {
+		fte = hash_entry(e, struct frame_table_entry, share_elem);
+		spte->pinned = true;
+		attach_page(fte, spte);
 	}
+	lock_release(&frame_lock);
+
+	return fte != NULL ? fte->frame : NULL;
+}
+
+/*
+ * Publish the frame SPTE was just loaded into as the shared copy of
+ * its file page.  If another process published the same page in the
+ * meantime, SPTE moves over to that frame and its own copy is freed.
+ * Returns the kernel address of the frame SPTE should map.
+ */
+void *frame_share_add(struct sup_page_table_entry *spte) {
+	struct frame_table_entry *fte = spte->fte;
+	struct hash_elem *e;
+	void *kpage;
 
+	lock_acquire(&frame_lock);
+	fte->inode = file_get_inode(spte->file);
+	fte->ofs = spte->ofs;
+	fte->read_bytes = spte->read_bytes;
+	fte->mmap = spte->type == PAGE_MMAP;
+	e = hash_insert(&share_table, &fte->share_elem);
+	if (e != NULL) {
+		detach_page(spte);
+		fte->inode = NULL;
+		destroy_frame(fte);
+		fte = hash_entry(e, struct frame_table_entry, share_elem);
+		attach_page(fte, spte);
+	}
+	kpage = fte->frame;
+	lock_release(&frame_lock);
+
+	return kpage;
+}
+
+/*
+ * Copy the residency of the parent's page PSPTE into the child's new
+ * page CSPTE, which belongs to the running thread.  A resident frame
+ * is shared copy-on-write: the parent's mapping is made read-only and
+ * the child maps the same frame read-only.  A swapped-out page shares
+ * the parent's swap slot.  Returns false if the child's mapping could
+ * not be made.
+ */
+bool frame_fork_page(struct sup_page_table_entry *pspte, struct sup_page_table_entry *cspte) {
+	uint32_t *cpd = thread_current()->pagedir;
+	bool success = true;
+
+	lock_acquire(&frame_lock);
+	if (pspte->location == ON_FRAME && pspte->fte != NULL && pspte->writable
+	    && pspte->type == PAGE_FILE
+	    && pagedir_is_dirty(pspte->owner->pagedir, pspte->user_vaddr))
+		pspte->type = PAGE_ANON;  /* No longer matches the file. */
+	cspte->type = pspte->type;
+	cspte->location = pspte->location;
+
+	if (pspte->location == ON_FRAME && pspte->fte != NULL) {
+		if (pspte->writable)
+			pagedir_set_writable(pspte->owner->pagedir, pspte->user_vaddr, false);
+		if (pagedir_set_page(cpd, cspte->user_vaddr, pspte->fte->frame, false))
+			attach_page(pspte->fte, cspte);
+		else
+			success = false;
+	}
+	else if (pspte->location == ON_ZERO)
+		success = pagedir_set_page(cpd, cspte->user_vaddr, zero_frame, false);
+	else if (pspte->location == ON_SWAP) {
+		cspte->swap_index = pspte->swap_index;
+		swap_dup(pspte->swap_index);
+	}
+	cspte->pinned = false;
+	lock_release(&frame_lock);
+
+	return success;
+}
+
+/*
+ * Resolve a write fault on SPTE's present, read-only copy-on-write
+ * mapping.  The last page mapping a frame simply gets write access
+ * back; otherwise the frame is copied into a private one.  Returns
+ * false if no frame could be had.
+ */
+bool frame_unshare(struct sup_page_table_entry *spte) {
+	struct frame_table_entry *fte, *copy;
+	uint32_t *pd = spte->owner->pagedir;
+
+	lock_acquire(&frame_lock);
+	fte = spte->fte;
+
+	/* Evicted meanwhile: the retried access will fault it back in. */
 	if (fte == NULL) {
-		return; 
+		lock_release(&frame_lock);
+		return true;
+	}
+
+	if (list_size(&fte->sptes) == 1) {
+		pagedir_set_writable(pd, spte->user_vaddr, true);
+		lock_release(&frame_lock);
+		return true;
 	}
-	//printf("frame %p corresponded to %p\n", fte, spte);
+
+	/* Pinning SPTE keeps FTE from being chosen for eviction. */
+	spte->pinned = true;
+	copy = get_frame(PAL_USER, spte->owner);
+	if (copy == NULL) {
+		spte->pinned = false;
+		lock_release(&frame_lock);
+		return false;
+	}
+	memcpy(copy->frame, fte->frame, PGSIZE);
+	detach_page(spte);
+	attach_page(copy, spte);
+	pagedir_clear_page(pd, spte->user_vaddr);
+	pagedir_set_page(pd, spte->user_vaddr, copy->frame, true);
+	spte->pinned = false;
+	lock_release(&frame_lock);
+
+	return true;
+}
+
+/*
+ * Write SPTE's page back to its file if it is a resident mapped-file
+ * page that any process sharing its frame has dirtied, and mark it
+ * clean in all of them.  A page that is not resident is already in
+ * its file.  The caller must hold sys_lock for writing, which is
+ * always taken before frame_lock.
+ */
+void frame_writeback(struct sup_page_table_entry *spte) {
+	ASSERT(lock_held_by_current_thread(&sys_lock.lock));
+
+	lock_acquire(&frame_lock);
+	if (spte->type == PAGE_MMAP && spte->fte != NULL && frame_test_and_clear_dirty(spte->fte))
+		file_write_at(spte->file, spte->fte->frame, spte->read_bytes, spte->ofs);
+	lock_release(&frame_lock);
+}
+
+/*
+ * Give up SPTE's frame now instead of waiting for eviction, writing a
+ * dirty mapped-file page back first.  Frames mapped by other pages as
+ * well, or currently pinned, are left alone.  Takes sys_lock, so the
+ * caller must not hold frame_lock.
+ */
+void frame_drop(struct sup_page_table_entry *spte) {
+	struct frame_table_entry *fte;
+
+	rwlock_write_acquire(&sys_lock);
+	lock_acquire(&frame_lock);
+	fte = spte->fte;
+	if (fte != NULL && list_size(&fte->sptes) == 1 && frame_is_evictable(fte)) {
+		page_out(fte, true);
+		destroy_frame(fte);
+	}
+	lock_release(&frame_lock);
+	rwlock_write_release(&sys_lock);
+}
+
+/*
+ * Make SPTE's frame look unused to the clock so that it is among the
+ * next to be evicted.
+ */
+void frame_deactivate(struct sup_page_table_entry *spte) {
+	lock_acquire(&frame_lock);
+	if (spte->fte != NULL) {
+		frame_test_and_clear_accessed(spte->fte);
+		spte->fte->age = 0;
+	}
+	lock_release(&frame_lock);
+}
+
+/*
+ * Keep SPTE's page resident until frame_unpin().  Fails if the page
+ * has no frame, for example because it was evicted after being
+ * loaded.  A page backed by the zero frame needs nothing.
+ */
+bool frame_pin(struct sup_page_table_entry *spte) {
+	bool pinned;
+
+	lock_acquire(&frame_lock);
+	pinned = spte->fte != NULL || spte->location == ON_ZERO;
+	if (pinned)
+		spte->pinned = true;
+	lock_release(&frame_lock);
+	return pinned;
+}
+
+void frame_unpin(struct sup_page_table_entry *spte) {
+	lock_acquire(&frame_lock);
+	spte->pinned = false;
+	lock_release(&frame_lock);
+}
+
+/*
+ * Keep SPTE's page resident until it is unmapped if LOCK, or let it be
+ * evicted again if not, counting it in its owner's locked_cnt.  Like
+ * frame_pin(), locking fails if the page has no frame.
+ */
+bool frame_set_locked(struct sup_page_table_entry *spte, bool lock) {
+	bool success = true;
+
+	lock_acquire(&frame_lock);
+	if (lock && spte->fte == NULL)
+		success = false;
+	else if (lock != spte->locked) {
+		spte->owner->locked_cnt += lock ? 1 : -1;
+		spte->locked = lock;
+	}
+	lock_release(&frame_lock);
+	return success;
+}
+
+/*
+ * Wait until SPTE's page, which page_out() has taken off its frame,
+ * has reached its backing store.  Waiting on frame_lock also lends
+ * the evicting thread our priority.
+ */
+void frame_wait_transit(struct sup_page_table_entry *spte) {
+	lock_acquire(&frame_lock);
+	while (spte->location == ON_TRANSIT)
+		cond_wait(&transit_done, &frame_lock);
+	lock_release(&frame_lock);
+}
+
+/* Add SPTE to the pages mapping FTE. */
+static void attach_page (struct frame_table_entry *fte, struct sup_page_table_entry *spte) {
+	spte->fte = fte;
+	list_push_back(&fte->sptes, &spte->fte_elem);
+	spte->owner->rss++;
+}
+
+/* Remove SPTE from the pages mapping its frame. */
+static void detach_page (struct sup_page_table_entry *spte) {
+	list_remove(&spte->fte_elem);
+	spte->fte = NULL;
+	spte->owner->rss--;
+}
+
+/* Give FTE's frame back to the user pool and drop the entry. */
+static void destroy_frame (struct frame_table_entry *fte) {
+	if (fte->inode != NULL)
+		hash_delete(&share_table, &fte->share_elem);
 	palloc_free_page(fte->frame);
-	list_remove(&fte->ft_elem);
-	free(fte);
-	//printf("deleted\n");
+	remove_frame_entry(fte);
+}
+
+/*
+ * Bring T's working-set sample up to the current clock cycle.  If T's
+ * running count is from the cycle just finished, it becomes the
+ * estimate; if it is older, T used nothing since and the estimate
+ * drops to zero.
+ */
+static void roll_wss (struct thread *t) {
+	if (t->ws_cycle == clock_cycle)
+		return;
+	t->wss = t->ws_cycle + 1 == clock_cycle ? t->ws_refs : 0;
+	t->ws_refs = 0;
+	t->ws_cycle = clock_cycle;
+}
+
+/*
+ * Estimated working set of T: the pages it was seen using during the
+ * last full revolution of the clock hand.
+ */
+size_t frame_wss (struct thread *t) {
+	size_t wss;
+
+	lock_acquire(&frame_lock);
+	roll_wss(t);
+	wss = t->wss;
+	lock_release(&frame_lock);
+	return wss;
 }
 
+/*
+ * Tell whether T maps FTE and nobody else does.
+ */
+static bool frame_owned_by (struct frame_table_entry *fte, struct thread *t) {
+	struct list_elem *e;
+
+	for (e=list_begin(&fte->sptes); e!=list_end(&fte->sptes); e=list_next(e))
+		if (list_entry(e, struct sup_page_table_entry, fte_elem)->owner != t)
+			return false;
+	return !list_empty(&fte->sptes);
+}
+
+/*
+ * Advance the clock hand over the global frame table, wrapping
+ * around at the end of the list.
+ */
 struct list_elem* find_clock_elem (void) {
-	if (clock_elem == NULL && !list_empty(&frame_table)) {
-		clock_elem = list_begin(&frame_table);
+	if (list_empty(&frame_table)) {
+		clock_elem = NULL;
 	}
 
-	else if (clock_elem->next == list_end(&frame_table)) {
+	else if (clock_elem == NULL || list_next(clock_elem) == list_end(&frame_table)) {
+		if (clock_elem != NULL)
+			clock_cycle++;
 		clock_elem = list_begin(&frame_table);
 	}
 
@@ -127,76 +604,217 @@ struct list_elem* find_clock_elem (void) {
 	return clock_elem;
 }
 
-bool evict_frame(void) {
-	/*Determine the algoritm to be evicted*/
-	/*For simplicity, we used FIFO*/
-	//printf("Evict started\n");
+/*
+ * Unlink FTE from the frame table and free it, moving the clock
+ * hand back one entry first if it points at FTE.
+ */
+static void remove_frame_entry (struct frame_table_entry *fte) {
+	if (clock_elem == &fte->ft_elem) {
+		if (list_prev(clock_elem) == list_head(&frame_table))
+			clock_elem = NULL;
+		else
+			clock_elem = list_prev(clock_elem);
+	}
+	list_remove(&fte->ft_elem);
+	free(fte);
+	frame_cnt--;
+}
+
+/*
+ * A frame may be evicted once every page mapping it is fully loaded
+ * and not locked resident, and every owner still has a page directory
+ * to unmap it from.
+ */
+static bool frame_is_evictable (struct frame_table_entry *fte) {
 	struct list_elem *e;
-	struct frame_table_entry *evict_frame_entry = NULL;
 
-	int cnt = 0;
-	int flag = 0;
-	int n, i;
-	n = list_size(&frame_table);
-	//printf("length : %d\n", list_size(&frame_table));
-	for (i=0; i<2 * n + 1; i++) {
-		e=find_clock_elem();
-		cnt++;
-		//e = find_clock_elem();
-		evict_frame_entry = list_entry(e, struct frame_table_entry, ft_elem);	  
-		//if(evict_frame_entry->owner == NULL) printf("!!!!!!!!\n");  
-		if (evict_frame_entry->spte->accessed == false && pagedir_is_accessed(thread_current()->pagedir, evict_frame_entry->spte->user_vaddr)) {
-			pagedir_set_accessed(thread_current()->pagedir, evict_frame_entry->spte->user_vaddr, false);
-			continue;
+	if (list_empty(&fte->sptes))
+		return false;
+	for (e=list_begin(&fte->sptes); e!=list_end(&fte->sptes); e=list_next(e)) {
+		struct sup_page_table_entry *spte = list_entry(e, struct sup_page_table_entry, fte_elem);
+		if (spte->pinned || spte->locked || spte->owner->pagedir == NULL)
+			return false;
+	}
+	return true;
+}
+
+/*
+ * Returns true if any process mapping FTE touched it since the last
+ * sample, clearing the accessed bits in every owner's page directory.
+ */
+static bool frame_test_and_clear_accessed (struct frame_table_entry *fte) {
+	struct list_elem *e;
+	bool accessed = false;
+
+	for (e=list_begin(&fte->sptes); e!=list_end(&fte->sptes); e=list_next(e)) {
+		struct sup_page_table_entry *spte = list_entry(e, struct sup_page_table_entry, fte_elem);
+		uint32_t *pd = spte->owner->pagedir;
+
+		if (pagedir_is_accessed(pd, spte->user_vaddr)) {
+			pagedir_set_accessed(pd, spte->user_vaddr, false);
+			roll_wss(spte->owner);
+			spte->owner->ws_refs++;
+			accessed = true;
 		}
+	}
+	return accessed;
+}
+
+/*
+ * Returns true if any process mapping FTE wrote to it, clearing the
+ * dirty bits in every owner's page directory.
+ */
+static bool frame_test_and_clear_dirty (struct frame_table_entry *fte) {
+	struct list_elem *e;
+	bool dirty = false;
+
+	for (e=list_begin(&fte->sptes); e!=list_end(&fte->sptes); e=list_next(e)) {
+		struct sup_page_table_entry *spte = list_entry(e, struct sup_page_table_entry, fte_elem);
+		uint32_t *pd = spte->owner->pagedir;
 
-		else if(evict_frame_entry->spte->accessed == false ){
-			evict_frame_entry->spte->location = ON_SWAP;
-			evict_frame_entry->spte->swap_index = swap_out(evict_frame_entry->frame);	        
-			flag = 1;
-		break;
+		if (pd != NULL && pagedir_is_dirty(pd, spte->user_vaddr)) {
+			pagedir_set_dirty(pd, spte->user_vaddr, false);
+			dirty = true;
 		}
 	}
+	return dirty;
+}
 
-	if (flag) {
-		if (evict_frame_entry->owner->pagedir != NULL) 
-	 	{
-	 		pagedir_clear_page(evict_frame_entry->owner->pagedir, evict_frame_entry->spte->user_vaddr);
-		 	//printf("clear page clear\n");
-	 	}
-	 	//printf("clear page access\n");
-		palloc_free_page(evict_frame_entry->frame);
-		//printf("Palloc success\n");
-		list_remove(&evict_frame_entry->ft_elem);
-		//printf("List remove\n");
-		free(evict_frame_entry);
-		//printf("Evict finished\n");
-		return true;
+/*
+ * Unmap FTE from every process mapping it and move its contents to
+ * wherever the page type says it lives.  Clean executable pages are
+ * simply dropped and re-read from the file later, mapped-file pages
+ * are written back to their file once however many processes share
+ * the frame, and everything else goes to swap.  A file page that was
+ * ever written becomes anonymous for good.
+ *
+ * Writing a mapped-file page needs the file system, so one may only
+ * be paged out by a caller that holds sys_lock for writing, which
+ * FS_LOCKED says.  It never goes to swap: a copy there could only be
+ * swapped back in as a private page.
+ * The pages are ON_TRANSIT while the I/O runs, so that an owner
+ * faulting on one waits in frame_wait_transit() instead of finding
+ * it still ON_FRAME and faulting again.
+ */
+static void page_out (struct frame_table_entry *fte, bool fs_locked) {
+	struct sup_page_table_entry *spte;
+	struct list_elem *e;
+	bool dirty = false;
+	int swap_index = -1;
+
+	for (e=list_begin(&fte->sptes); e!=list_end(&fte->sptes); e=list_next(e)) {
+		uint32_t *pd;
+
+		spte = list_entry(e, struct sup_page_table_entry, fte_elem);
+		pd = spte->owner->pagedir;
+		pagedir_clear_page(pd, spte->user_vaddr);
+		dirty = dirty || pagedir_is_dirty(pd, spte->user_vaddr);
+		spte->location = ON_TRANSIT;
 	}
 
-	return false;
+	while (!list_empty(&fte->sptes)) {
+		spte = list_entry(list_front(&fte->sptes), struct sup_page_table_entry, fte_elem);
+		detach_page(spte);
+
+		if (spte->type == PAGE_MMAP) {
+			ASSERT(fs_locked);
+			if (dirty)
+				file_write_at(spte->file, fte->frame, spte->read_bytes, spte->ofs);
+			dirty = false;
+			spte->location = ON_MMAP;
+		}
+
+		else if (spte->type == PAGE_FILE && !dirty) {
+			spte->location = ON_FILESYS;
+		}
+
+		else {
+			/* Copy-on-write sharers all refer to the same slot. */
+			if (swap_index < 0)
+				swap_index = swap_out(fte->frame);
+			else
+				swap_dup(swap_index);
+			spte->type = PAGE_ANON;
+			spte->swap_index = swap_index;
+			spte->location = ON_SWAP;
+		}
+	}
+	cond_broadcast(&transit_done, &frame_lock);
 }
 
-void free_frame_nolock (uint8_t *kpage) {
+/*
+ * Global clock with aging.  Every frame the hand passes has its age
+ * shifted right, and the accessed bits of its page in the owners'
+ * page directories are folded into the top bit and then cleared.
+ * This way frames touched by any process, not just the faulting one,
+ * keep a high age and survive.  The first untouched frame whose age
+ * has decayed to zero is evicted; otherwise, after two sweeps, the
+ * youngest-aged untouched frame seen is taken.  If T is not NULL only
+ * frames mapped by T alone are considered.
+ *
+ * Writing back a mapped-file frame needs sys_lock, which is taken
+ * before frame_lock, so it is only tried, the first time such a frame
+ * comes up.  If it is busy, or the evicting thread holds it already
+ * and may be in the middle of a file system call, mapped-file frames
+ * are passed over: even a clean one could be dirtied by a sharer
+ * before page_out() unmaps it.
+ */
+bool evict_frame(struct thread *t) {
 	struct list_elem *e;
-	struct frame_table_entry *fte = NULL;
-	for (e=list_begin(&frame_table); e!=list_end(&frame_table); e=list_next(e)) {
-		if (list_entry(e, struct frame_table_entry, ft_elem)->frame == kpage) {
-			fte = list_entry(e, struct frame_table_entry, ft_elem);
-			break;
+	struct frame_table_entry *fte;
+	struct frame_table_entry *evict_frame_entry = NULL;
+	bool held = lock_held_by_current_thread(&sys_lock.lock);
+	bool fs_tried = false, fs_locked = false;
+	int n, i;
+
+	n = list_size(&frame_table);
+	for (i=0; i<2 * n; i++) {
+		e = find_clock_elem();
+		fte = list_entry(e, struct frame_table_entry, ft_elem);
+		if (!frame_is_evictable(fte) || (t != NULL && !frame_owned_by(fte, t)))
+			continue;
+		if (fte->mmap && !fs_locked) {
+			if (!fs_tried && !held)
+				fs_locked = rwlock_write_try_acquire(&sys_lock);
+			fs_tried = true;
+			if (!fs_locked)
+				continue;
 		}
-	}
 
-	if (fte == NULL) {
-		return;
-	}
-	//printf("frame free started with %p\n", fte->spte);
+		fte->age >>= 1;
+		if (frame_test_and_clear_accessed(fte)) {
+			fte->age |= FRAME_AGE_MSB;
+			continue;
+		}
 
-	palloc_free_page(fte->frame);
-	list_remove(&fte->ft_elem);
-	free(fte);
-	//printf("frame free finished\n");
+		if (evict_frame_entry == NULL || fte->age < evict_frame_entry->age)
+			evict_frame_entry = fte;
+		if (fte->age == 0)
+			break;
+	}
 
+	if (evict_frame_entry != NULL) {
+		page_out(evict_frame_entry, fs_locked);
+		destroy_frame(evict_frame_entry);
+	}
+	if (fs_locked)
+		rwlock_write_release(&sys_lock);
+	return evict_frame_entry != NULL;
 }
 
+static unsigned share_hash (const struct hash_elem *e, void *aux UNUSED) {
+	struct frame_table_entry *fte = hash_entry(e, struct frame_table_entry, share_elem);
+	return hash_bytes(&fte->inode, sizeof(fte->inode)) ^ hash_int(fte->ofs) ^ hash_int(fte->read_bytes) ^ fte->mmap;
+}
 
+static bool share_less (const struct hash_elem *a, const struct hash_elem *b, void *aux UNUSED) {
+	struct frame_table_entry *x = hash_entry(a, struct frame_table_entry, share_elem);
+	struct frame_table_entry *y = hash_entry(b, struct frame_table_entry, share_elem);
+	if (x->inode != y->inode)
+		return x->inode < y->inode;
+	if (x->ofs != y->ofs)
+		return x->ofs < y->ofs;
+	if (x->read_bytes != y->read_bytes)
+		return x->read_bytes < y->read_bytes;
+	return x->mmap < y->mmap;
+}
@@ -2,23 +2,57 @@
 #define VM_FRAME_H
 
 #include <list.h>
+#include <hash.h>
 #include "threads/palloc.h"
+#include "filesys/off_t.h"
+
+struct sup_page_table_entry;
+struct thread;
+struct inode;
 
 struct frame_table_entry
 {
 	uint8_t* frame; /*for the palloced address*/
-	struct thread* owner; /*current thread*/
-	struct sup_page_table_entry* spte;
+	struct list sptes; /*pages mapping this frame*/
+	struct inode *inode; /*file page shared between processes, or NULL*/
+	off_t ofs;
+	uint32_t read_bytes; /*file bytes in the page, rest is zeros*/
+	bool mmap; /*page of a file mapping, not read-only code*/
+	struct hash_elem share_elem;
+	uint8_t age; /*aging counter, msb set when an owner touched it*/
 	struct list_elem ft_elem;
 };
 
+/* Age given to a frame whose accessed bit was found set. */
+#define FRAME_AGE_MSB 0x80
+
+/* Free user frame watermarks for the reclaim daemon, in 1/64ths
+   of the user pool.  The daemon is woken below the low mark and
+   evicts until the high mark is reached again. */
+#define RECLAIM_LOW_WATERMARK 2
+#define RECLAIM_HIGH_WATERMARK 4
+
 void frame_init (void);
+void frame_reclaim_init (void);
+void *frame_zero_page (void);
 void print_all_frame(void);
+bool frame_can_prefetch(void);
 void* allocate_frame (enum palloc_flags flag, struct sup_page_table_entry* spte);
 void free_frame(uint8_t *kpage);
 //bool evict_frame(uint32_t *pagedir);
 struct list_elem* find_clock_elem (void);
-void find_and_free_frame(struct sup_page_table_entry *spte);
-bool evict_frame(void);
-void free_frame_nolock (uint8_t *kpage);
+void frame_release(struct sup_page_table_entry *spte);
+void *frame_share_get(struct sup_page_table_entry *spte);
+void *frame_share_add(struct sup_page_table_entry *spte);
+bool frame_fork_page(struct sup_page_table_entry *pspte, struct sup_page_table_entry *cspte);
+bool frame_unshare(struct sup_page_table_entry *spte);
+void frame_writeback(struct sup_page_table_entry *spte);
+void frame_drop(struct sup_page_table_entry *spte);
+void frame_deactivate(struct sup_page_table_entry *spte);
+bool frame_pin(struct sup_page_table_entry *spte);
+void frame_unpin(struct sup_page_table_entry *spte);
+bool frame_set_locked(struct sup_page_table_entry *spte, bool lock);
+void frame_wait_transit(struct sup_page_table_entry *spte);
+bool evict_frame(struct thread *t);
+size_t frame_wss(struct thread *t);
 #endif /* vm/frame.h */
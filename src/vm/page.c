@@ -3,10 +3,9 @@
 #include "vm/swap.h"
 #include "threads/malloc.h"
 #include "threads/palloc.h"
+#include "threads/pte.h"
 #include <stdio.h>
 #include "userprog/pagedir.h"
-#include <hash.h>
-#include "lib/kernel/hash.h"
 #include "devices/disk.h"
 #include "threads/synch.h"
 #include "threads/vaddr.h"
@@ -14,12 +13,30 @@
 #include "filesys/directory.h"
 #include "filesys/file.h"
 #include "filesys/filesys.h"
+#include "filesys/inode.h"
 #include "userprog/pagedir.h"
 #include "userprog/process.h"
 #include "userprog/syscall.h"
 #include "threads/thread.h"
 #include <stdlib.h>
 #include <string.h>
+#include <syscall-nr.h>
+
+/* Slots in the top level of the table, one per user page table, and
+   in each leaf table, one per page. */
+#define SUPT_DIR_CNT ((size_t) pd_no (PHYS_BASE))
+#define SUPT_LEAF_CNT (PGSIZE / sizeof (struct sup_page_table_entry *))
+
+/* A page that entries are carved out of. */
+struct supt_slab {
+	struct list_elem elem;
+	struct sup_page_table_entry entries[];
+};
+
+#define SLAB_ENTRY_CNT ((PGSIZE - sizeof (struct supt_slab)) / sizeof (struct sup_page_table_entry))
+
+static struct sup_page_table_entry **find_slot(struct sup_page_table *supt, const void *addr, bool create);
+static struct sup_page_table_entry *new_entry(struct sup_page_table *supt);
 
 /*
  * Initialize supplementary page table
@@ -27,63 +44,275 @@
 
 //static bool install_page (void *upage, void *kpage, bool writable);
 
-void 
-page_init (struct hash *supt)
+bool
+page_init (struct sup_page_table *supt)
 {
-	hash_init(supt, page_hash_hash, page_hash_less, NULL);
-	//printf("hash init success? %d\n", flag);
+	list_init(&supt->slabs);
+	list_init(&supt->free_entries);
+	supt->dir = palloc_get_page(PAL_ZERO);
+	return supt->dir != NULL;
+}
+
+/*
+ * Return the leaf slot for the page containing ADDR.  If the leaf
+ * table is missing it is allocated when CREATE is true, otherwise
+ * NULL is returned.
+ */
+static struct sup_page_table_entry **
+find_slot (struct sup_page_table *supt, const void *addr, bool create)
+{
+	size_t pde = pd_no(addr);
+
+	if (supt->dir == NULL || pde >= SUPT_DIR_CNT)
+		return NULL;
+	if (supt->dir[pde] == NULL) {
+		if (!create)
+			return NULL;
+		supt->dir[pde] = palloc_get_page(PAL_ZERO);
+		if (supt->dir[pde] == NULL)
+			return NULL;
+	}
+	return &supt->dir[pde][pt_no(addr)];
+}
+
+/*
+ * Take an unused entry, carving a new slab into entries if there are
+ * none left.
+ */
+static struct sup_page_table_entry *
+new_entry (struct sup_page_table *supt)
+{
+	if (list_empty(&supt->free_entries)) {
+		struct supt_slab *slab = palloc_get_page(0);
+		size_t i;
+
+		if (slab == NULL)
+			return NULL;
+		list_push_back(&supt->slabs, &slab->elem);
+		for (i = 0; i < SLAB_ENTRY_CNT; i++)
+			list_push_back(&supt->free_entries, &slab->entries[i].fte_elem);
+	}
+	return list_entry(list_pop_front(&supt->free_entries), struct sup_page_table_entry, fte_elem);
 }
 
 /*
  * Make new supplementary page table entry for addr 
  */
 struct sup_page_table_entry *
-allocate_page (struct hash *supt, void *addr)
+allocate_page (struct sup_page_table *supt, void *addr)
 {
 	//printf("page allocation started\n");
-	struct sup_page_table_entry *spte = malloc(sizeof(struct sup_page_table_entry));
+	struct sup_page_table_entry **slot = find_slot(supt, addr, true);
+	struct sup_page_table_entry *spte;
+
+	if (slot == NULL || *slot != NULL) return NULL;
+	spte = new_entry(supt);
 	//printf("spte %p\n", spte);
 	if (spte == NULL) return NULL;
 
 	spte->user_vaddr = pg_round_down(addr);
-	spte->accessed = true;
+	spte->pinned = true;
 	spte->swap_index = -1;
 	spte->writable = true;
 	spte->file = NULL;
-	//printf("reached here \n");
-	if(hash_insert(supt, &spte->hs_elem) != NULL) {
-		//printf("hash insert failed \n");
-		free(spte);
-		return NULL;
-	}
-	//printf("hash table size : %d\n", hash_size(supt));
+	spte->type = PAGE_ANON;
+	spte->owner = thread_current();
+	spte->fte = NULL;
+	spte->advice = MADV_NORMAL;
+	spte->locked = false;
+	*slot = spte;
 	//printf("page allocation finished");
 	return spte;
 }
 
-void free_page(struct hash_elem *hs_elem, void *aux UNUSED) {
+/*
+ * Find the entry for the page containing ADDR, or NULL.
+ */
+struct sup_page_table_entry *
+page_lookup (struct sup_page_table *supt, const void *addr)
+{
+	struct sup_page_table_entry **slot = find_slot(supt, addr, false);
+	return slot != NULL ? *slot : NULL;
+}
+
+/*
+ * Take SPTE out of the table and give its memory back to the table.
+ * Its frame and swap slot must already be released.
+ */
+void
+page_remove (struct sup_page_table *supt, struct sup_page_table_entry *spte)
+{
+	*find_slot(supt, spte->user_vaddr, false) = NULL;
+	list_push_front(&supt->free_entries, &spte->fte_elem);
+}
+
+void free_page(struct sup_page_table *supt, struct sup_page_table_entry *spte) {
 	//printf("page free started\n");
-	struct sup_page_table_entry *spte = hash_entry(hs_elem, struct sup_page_table_entry, hs_elem);
 	//if (spte->file != NULL) file_close(spte->file);
+	frame_release(spte);
 	if(spte->location == ON_SWAP) swap_free(spte->swap_index);
-	//if (spte->location != ON_FRAME) find_and_free_frame(spte);
+	if (spte->locked)
+		spte->owner->locked_cnt--;
 	//printf("free spte %p\n", spte);
-	free(spte);
+	page_remove(supt, spte);
 	//need to free the frame 
 	//printf("page free finished\n");
 
 }
 
-void destroy_supt(struct hash *supt, void *aux UNUSED) {
-	hash_destroy(supt, free_page);
+/*
+ * Release every page in SUPT, then the table itself.
+ */
+void destroy_supt(struct sup_page_table *supt) {
+	size_t pde, pte;
+
+	if (supt->dir == NULL) return;
+	for (pde = 0; pde < SUPT_DIR_CNT; pde++) {
+		if (supt->dir[pde] == NULL) continue;
+		for (pte = 0; pte < SUPT_LEAF_CNT; pte++)
+			if (supt->dir[pde][pte] != NULL)
+				free_page(supt, supt->dir[pde][pte]);
+		palloc_free_page(supt->dir[pde]);
+	}
+	palloc_free_page(supt->dir);
+	supt->dir = NULL;
+
+	while (!list_empty(&supt->slabs))
+		palloc_free_page(list_entry(list_pop_front(&supt->slabs), struct supt_slab, elem));
+}
+
+/*
+ * Fill a new frame for SPTE with its file data followed by zeros.
+ */
+static void *read_file_page(struct sup_page_table_entry *spte) {
+	void *kpage;
+
+	if (spte->zero_bytes == PGSIZE)
+		return allocate_frame(PAL_USER | PAL_ZERO, spte);
+
+	kpage = allocate_frame(PAL_USER, spte);
+	if (kpage == NULL) return NULL;
+	if (file_read_at(spte->file, kpage, spte->read_bytes, spte->ofs) != (int) spte->read_bytes) {
+		frame_release(spte);
+		return NULL;
+	}
+	memset(kpage + spte->read_bytes, 0, spte->zero_bytes);
+	return kpage;
+}
+
+/*
+ * Map KPAGE at SPTE's user address in the current process, giving
+ * the frame back on failure.
+ */
+static bool map_page(struct sup_page_table_entry *spte, void *kpage) {
+	uint32_t *pd = thread_current()->pagedir;
+
+	if (pagedir_get_page(pd, spte->user_vaddr) != NULL || !pagedir_set_page(pd, spte->user_vaddr, kpage, spte->writable)) {
+		frame_release(spte);
+		return false;
+	}
+	return true;
+}
+
+/*
+ * Map the shared zero frame read-only at SPTE's user address.
+ */
+static bool map_zero_page(struct sup_page_table_entry *spte) {
+	uint32_t *pd = thread_current()->pagedir;
+
+	if (pagedir_get_page(pd, spte->user_vaddr) != NULL || !pagedir_set_page(pd, spte->user_vaddr, frame_zero_page(), false))
+		return false;
+	spte->location = ON_ZERO;
+	return true;
+}
+
+/*
+ * Read SPTE's page from its file, or find it already resident, and map
+ * it.  Read-only code pages are shared by every process running the
+ * same executable, and pages of a file mapping by every process
+ * mapping the file.
+ */
+static bool load_file_page(struct sup_page_table_entry *spte) {
+	bool shared = (spte->location == ON_FILESYS && !spte->writable && spte->zero_bytes != PGSIZE)
+	              || spte->type == PAGE_MMAP;
+	void *kpage = NULL;
+
+	if (shared)
+		kpage = frame_share_get(spte);
+	if (kpage == NULL) {
+		kpage = read_file_page(spte);
+		if (kpage == NULL) return false;
+		if (shared)
+			kpage = frame_share_add(spte);
+	}
+	return map_page(spte, kpage);
 }
 
-bool load_page(struct sup_page_table_entry *spte) {
+/*
+ * After a fault on SPTE, a page of a file mapping or executable at
+ * LOCATION, also load up to FAULT_AROUND_PAGES following pages that
+ * continue the same file.  Only pages whose data is already in the
+ * buffer cache are taken, and only while frames are to spare, so a
+ * sequential scan gets one fault per batch instead of one per page.
+ * A mapping advised MADV_SEQUENTIAL reads READ_AHEAD_PAGES ahead from
+ * disk and lets the pages behind it go first; MADV_RANDOM turns this
+ * off.
+ */
+static void fault_around(struct sup_page_table_entry *spte, enum page_location location) {
+	struct sup_page_table *supt = &thread_current()->supt;
+	struct inode *inode = file_get_inode(spte->file);
+	int window = FAULT_AROUND_PAGES;
+	bool sequential = spte->advice == MADV_SEQUENTIAL;
+	int i;
+
+	if (spte->advice == MADV_RANDOM)
+		return;
+	if (sequential) {
+		window = READ_AHEAD_PAGES;
+		for (i = 1; i <= window; i++) {
+			struct sup_page_table_entry *prev = page_lookup(supt, (uint8_t *) spte->user_vaddr - i * PGSIZE);
+			if (prev == NULL || prev->file != spte->file) break;
+			if (prev->location == ON_FRAME)
+				frame_deactivate(prev);
+		}
+	}
+
+	for (i = 1; i <= window; i++) {
+		struct sup_page_table_entry *next;
+
+		next = page_lookup(supt, (uint8_t *) spte->user_vaddr + i * PGSIZE);
+		if (next == NULL) return;
+
+		if (next->location != location || next->file == NULL
+		    || file_get_inode(next->file) != inode
+		    || next->ofs != spte->ofs + i * PGSIZE
+		    || next->zero_bytes == PGSIZE)
+			return;
+		if (!frame_can_prefetch())
+			return;
+		if (!sequential && !inode_cached(inode, next->read_bytes, next->ofs))
+			return;
+		if (!load_file_page(next)) return;
+		next->pinned = false;
+		next->location = ON_FRAME;
+	}
+}
+
+/*
+ * Bring SPTE's page into memory and map it.  WRITE tells whether the
+ * faulting access was a write; reads of all-zero pages are served by
+ * the shared zero frame.
+ */
+bool load_page(struct sup_page_table_entry *spte, bool write) {
 	//printf("page load start\n");
 	void *kpage = NULL;
-	if (spte->location == ON_FRAME){
+	if (spte->location == ON_TRANSIT) {
+		frame_wait_transit(spte);
+		return load_page(spte, write);
+	}
+
+	if (spte->location == ON_FRAME || spte->location == ON_ZERO){
 		//spte->accessed = false;
-		spte->location = ON_FRAME;
 		return true;
 		//printf("page load start\n");
 	} 
@@ -91,103 +320,24 @@ bool load_page(struct sup_page_table_entry *spte) {
 	else if (spte->location == ON_SWAP) {
 		//printf("load with swap index = %d\n", spte->swap_index);
 		kpage = allocate_frame(PAL_USER, spte);
-		
 		if (kpage == NULL) return false;
-		if (spte == NULL) return false;
-		
+
 		swap_in(kpage, spte->swap_index);
-		if(pagedir_get_page(thread_current()->pagedir, spte->user_vaddr)!=NULL || !pagedir_set_page(thread_current()->pagedir, spte->user_vaddr, kpage, spte->writable))
-		{
-          //spte->accessed = false;
-		  //spte->location = ON_FRAME;
-          free_frame (kpage);
-          return false;
-        }
-		spte->accessed = false;
-		spte->location = ON_FRAME;
+		if (!map_page(spte, kpage)) return false;
 		//printf("swap load success!\n");
-
 	}
 
-	else if (spte->location == ON_FILESYS) {
-		//printf("file load start\n");
-		//printf("spte address : %p\n", spte);
-		//printf("file position before seek : %d\n", file_tell(spte->file));
-
-		file_seek (spte->file, spte->ofs);
-		//printf("file position after seek : %d\n", file_tell(spte->file));
-		if (spte->zero_bytes == PGSIZE) {
-			//printf("memset\n");
-			kpage = allocate_frame(PAL_USER | PAL_ZERO, spte);
-			if (kpage == NULL) return false;
-			memset(kpage,0,PGSIZE);
-		}
-		
-		else if (spte->zero_bytes != 0 ){
-	      kpage = allocate_frame(PAL_USER, spte);
-	      if (file_read(spte->file, kpage, spte->read_bytes) != (int) spte->read_bytes)
-	        {
-	          //printf("error 2!\n");
-	          free_frame (kpage);
-	          return false;
-	        }	        
- 			memset (kpage + spte->read_bytes, 0, spte->zero_bytes);
-		}
-
-		else {
-	      kpage = allocate_frame(PAL_USER, spte);
-	      if (file_read(spte->file, kpage, spte->read_bytes) != PGSIZE)
-	        {
-	          free_frame (kpage);
-	          return false;
-	        }
-		}
-
-		if(pagedir_get_page(thread_current()->pagedir, spte->user_vaddr)!=NULL || !pagedir_set_page(thread_current()->pagedir, spte->user_vaddr, kpage, spte->writable))
-		{          //spte->accessed = false;
-		  //spte->location = ON_FRAME;
-          free_frame (kpage);
-          return false;
-        }
-		//printf("file load finished\n");
+	else if (spte->location == ON_FILESYS && spte->zero_bytes == PGSIZE && !write) {
+		return map_zero_page(spte);
 	}
 
-	else if (spte->location == ON_MMAP) {
-		file_seek (spte->file, spte->ofs);
-		//printf("file position after seek : %d\n", file_tell(spte->file));
-		if (spte->zero_bytes == PGSIZE) {
-			//printf("memset\n");
-			kpage = allocate_frame(PAL_USER | PAL_ZERO, spte);
-			if (kpage == NULL) return false;
-			memset(kpage,0,PGSIZE);
-		}
-		
-		else if (spte->zero_bytes != 0 ){
-	      kpage = allocate_frame(PAL_USER, spte);
-	      if (file_read(spte->file, kpage, spte->read_bytes) != (int) spte->read_bytes)
-	        {
-	          //printf("error 2!\n");
-	          free_frame (kpage);
-	          return false;
-	        }	        
- 			memset (kpage + spte->read_bytes, 0, spte->zero_bytes);
-		}
+	else if (spte->location == ON_FILESYS || spte->location == ON_MMAP) {
+		enum page_location location = spte->location;
 
-		else {
-	      kpage = allocate_frame(PAL_USER, spte);
-	      if (file_read(spte->file, kpage, spte->read_bytes) != PGSIZE)
-	        {
-	          free_frame (kpage);
-	          return false;
-	        }
-		}
-
-		if(pagedir_get_page(thread_current()->pagedir, spte->user_vaddr)!=NULL || !pagedir_set_page(thread_current()->pagedir, spte->user_vaddr, kpage, spte->writable))
-		{          //spte->accessed = false;
-		  //spte->location = ON_FRAME;
-          free_frame (kpage);
-          return false;
-        }
+		if (!load_file_page(spte)) return false;
+		/* Still pinned, so prefetching cannot evict it. */
+		fault_around(spte, location);
+		//printf("file load finished\n");
 	}
 
 	else if (spte->location == IMSI_EXTENDED) {
@@ -197,42 +347,242 @@ bool load_page(struct sup_page_table_entry *spte) {
 
 	//print_all_frame();
     //printf("totally load success!\n");
-	spte->accessed = false;
+	spte->pinned = false;
+	spte->location = ON_FRAME;
+	return true;
+}
+
+/*
+ * Give up the shared zero frame for a private, zeroed one on the
+ * first write to a writable page.  Returns false if SPTE is not
+ * writable or no frame could be had.
+ */
+bool page_copy_on_write(struct sup_page_table_entry *spte) {
+	void *kpage;
+
+	if (!spte->writable)
+		return false;
+	/* A file mapping's frame is shared on purpose, never copied. */
+	if (spte->type == PAGE_MMAP)
+		return true;
+	if (spte->location == ON_FRAME)
+		return frame_unshare(spte);
+	/* Evicted or being evicted: the retried access faults it back in. */
+	if (spte->location != ON_ZERO)
+		return true;
+
+	kpage = allocate_frame(PAL_USER | PAL_ZERO, spte);
+	if (kpage == NULL) return false;
+
+	pagedir_clear_page(thread_current()->pagedir, spte->user_vaddr);
+	if (!map_page(spte, kpage)) return false;
+	spte->pinned = false;
 	spte->location = ON_FRAME;
 	return true;
 }
 
-unsigned page_hash_hash(const struct hash_elem *element, void *aux UNUSED) {
-	struct sup_page_table_entry *spte = hash_entry(element, struct  sup_page_table_entry, hs_elem);
-	//return hash_int((int) spte->user_vaddr);
-	return hash_bytes(&spte->user_vaddr, sizeof(spte->user_vaddr)); 
+/*
+ * Copy every page of PARENT's supplemental page table into the running
+ * thread's, sharing frames and swap slots copy-on-write.  Mapped-file
+ * pages are left to the caller, which gives the child its own file.
+ */
+bool page_fork(struct thread *parent) {
+	struct sup_page_table *psupt = &parent->supt;
+	size_t pde, pte;
+
+	for (pde = 0; pde < SUPT_DIR_CNT; pde++) {
+		if (psupt->dir[pde] == NULL) continue;
+		for (pte = 0; pte < SUPT_LEAF_CNT; pte++) {
+			struct sup_page_table_entry *pspte = psupt->dir[pde][pte];
+			struct sup_page_table_entry *cspte;
+
+			if (pspte == NULL || pspte->type == PAGE_MMAP)
+				continue;
+			cspte = allocate_page(&thread_current()->supt, pspte->user_vaddr);
+			if (cspte == NULL)
+				return false;
+			cspte->file = pspte->file;
+			cspte->ofs = pspte->ofs;
+			cspte->read_bytes = pspte->read_bytes;
+			cspte->zero_bytes = pspte->zero_bytes;
+			cspte->writable = pspte->writable;
+			if (!frame_fork_page(pspte, cspte))
+				return false;
+		}
+	}
+	return true;
+}
+
+/*
+ * Write back the dirty mapped-file pages among the LENGTH bytes at
+ * ADDR, keeping them mapped.  Returns false if part of the range is
+ * not mapped.
+ */
+bool page_sync(struct sup_page_table *supt, void *addr, size_t length) {
+	size_t ofs;
+	bool success = true;
+
+	rwlock_write_acquire(&sys_lock);
+	for (ofs = 0; ofs < length; ofs += PGSIZE) {
+		struct sup_page_table_entry *spte = page_lookup(supt, (uint8_t *) addr + ofs);
+		if (spte == NULL) {
+			success = false;
+			break;
+		}
+		if (spte->type == PAGE_MMAP)
+			frame_writeback(spte);
+	}
+	rwlock_write_release(&sys_lock);
+	return success;
+}
+
+/*
+ * Apply the MADV_* ADVICE to the mapped-file pages among the LENGTH
+ * bytes at ADDR.  Returns false if part of the range is not a file
+ * mapping.
+ */
+bool page_advise(struct sup_page_table *supt, void *addr, size_t length, int advice) {
+	size_t ofs;
+
+	if (advice < MADV_NORMAL || advice > MADV_DONTNEED)
+		return false;
+	for (ofs = 0; ofs < length; ofs += PGSIZE) {
+		struct sup_page_table_entry *spte = page_lookup(supt, (uint8_t *) addr + ofs);
+		if (spte == NULL || spte->type != PAGE_MMAP)
+			return false;
+	}
+
+	for (ofs = 0; ofs < length; ofs += PGSIZE) {
+		struct sup_page_table_entry *spte = page_lookup(supt, (uint8_t *) addr + ofs);
+
+		switch (advice) {
+			case MADV_NORMAL:
+			case MADV_RANDOM:
+			case MADV_SEQUENTIAL:
+				spte->advice = advice;
+				break;
+			case MADV_WILLNEED:
+				if (spte->location == ON_MMAP && frame_can_prefetch())
+					load_page(spte, false);
+				break;
+			case MADV_DONTNEED:
+				frame_drop(spte);
+				break;
+		}
+	}
+	return true;
 }
 
-bool page_hash_less(const struct hash_elem *a, const struct hash_elem *b, void *aux UNUSED) {
-	struct sup_page_table_entry *x = hash_entry(a, struct sup_page_table_entry, hs_elem);
-	struct sup_page_table_entry *y = hash_entry(b, struct sup_page_table_entry, hs_elem);
-	return  x->user_vaddr <  y->user_vaddr;
+/*
+ * Read in and map every not yet loaded mapped-file page among the
+ * LENGTH bytes at ADDR, in file order so that each read continues
+ * where the buffer cache left off.  With LOCK the pages also stay
+ * resident until they are unmapped.  Returns false if a page could
+ * not be loaded, or if locking them would take the process over
+ * 1/LOCKED_SHARE of the user pool.
+ */
+bool page_populate(struct sup_page_table *supt, void *addr, size_t length, bool lock) {
+	struct thread *t = thread_current();
+	size_t ofs;
+
+	if (lock) {
+		size_t cnt = 0;
+
+		for (ofs = 0; ofs < length; ofs += PGSIZE) {
+			struct sup_page_table_entry *spte = page_lookup(supt, (uint8_t *) addr + ofs);
+			if (spte != NULL && !spte->locked)
+				cnt++;
+		}
+		if (t->locked_cnt + cnt > palloc_user_page_cnt() / LOCKED_SHARE)
+			return false;
+	}
+
+	for (ofs = 0; ofs < length; ofs += PGSIZE) {
+		struct sup_page_table_entry *spte = page_lookup(supt, (uint8_t *) addr + ofs);
+
+		if (spte == NULL || spte->type != PAGE_MMAP)
+			return false;
+		/*
+		 * Swapped out and in-transit pages are read in too, so that
+		 * only resident pages are ever counted as locked.  The page
+		 * may be evicted again before it is locked; load it again.
+		 */
+		do {
+			if (!load_page(spte, false))
+				return false;
+		} while (!frame_set_locked(spte, lock));
+	}
+	return true;
 }
 
+/*
+ * Fault in and pin every page of the SIZE bytes at ADDR so a system
+ * call can access them while holding locks, without page faults and
+ * without the pages being evicted under it.  WRITE means the kernel
+ * will store into the buffer.  Returns false, with nothing left
+ * pinned, if part of the range is not valid user memory.
+ */
+bool page_pin_range(const void *addr, size_t size, bool write) {
+	const uint8_t *upage;
+	const uint8_t *end = (const uint8_t *) addr + size;
 
+	if (size == 0)
+		return true;
+	if (end < (const uint8_t *) addr)
+		return false;
+	for (upage = pg_round_down(addr); upage < end; upage += PGSIZE) {
+		/* check_address() grows the stack only near esp. */
+		const void *p = upage < (const uint8_t *) addr ? addr : (const void *) upage;
+		struct sup_page_table_entry *spte;
+
+		/* Retry from check_address() if the page is evicted meanwhile. */
+		do {
+			spte = is_user_vaddr(p) ? check_address((void *) p) : NULL;
+			if (spte == NULL || (write && (!spte->writable || !page_copy_on_write(spte)))) {
+				page_unpin_range(pg_round_down(addr), upage - (const uint8_t *) pg_round_down(addr));
+				return false;
+			}
+		} while (!frame_pin(spte));
+	}
+	return true;
+}
 
-bool stack_growth(struct hash *supt, void *addr){
+/*
+ * Undo page_pin_range() for the SIZE bytes at ADDR.
+ */
+void page_unpin_range(const void *addr, size_t size) {
+	const uint8_t *upage;
+	const uint8_t *end = (const uint8_t *) addr + size;
+
+	for (upage = pg_round_down(addr); upage < end; upage += PGSIZE) {
+		struct sup_page_table_entry *spte = page_lookup(&thread_current()->supt, upage);
+		if (spte != NULL)
+			frame_unpin(spte);
+	}
+}
+
+bool stack_growth(struct sup_page_table *supt, void *addr, bool write){
 	//return true; //for swap testing, can delete if we want to debug stack growth
 	struct sup_page_table_entry *spte = allocate_page(supt, addr);
 	//printf("spte address : %p\n", spte);
 	if (spte == NULL)
 		return false;
 
+	if (!write) {
+		if (map_zero_page(spte)) {
+			spte->pinned = false;
+			return true;
+		}
+		page_remove(supt, spte);
+		return false;
+	}
+
     spte->location = ON_FRAME;
 
 	uint8_t *kpage = allocate_frame(PAL_USER | PAL_ZERO, spte);
 	//printf("allocate succeed in stack growth\n");
 	if (kpage == NULL){
-  		struct sup_page_table_entry imsi;
-	  	imsi.user_vaddr = pg_round_down(addr);
-		struct hash_elem *e = hash_find(&thread_current()->supt, &(imsi.hs_elem));
-		hash_delete(&thread_current()->supt, e);
-		free(spte);
+		page_remove(supt, spte);
 		return false;
 	}
 
@@ -242,6 +592,7 @@ bool stack_growth(struct hash *supt, void *addr){
         return false;
     }
 
+	spte->pinned = false;
 	return true;
 }
 
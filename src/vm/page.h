@@ -1,6 +1,6 @@
 #ifndef VM_PAGE_H
 #define VM_PAGE_H
-#include <hash.h>
+#include <list.h>
 #include <inttypes.h>
 #include "filesys/directory.h"
 #include "filesys/file.h"
@@ -12,9 +12,39 @@ enum page_location {
 	ON_SWAP,
 	ON_FILESYS,
 	ON_MMAP,
+	ON_ZERO, /*mapped read-only to the shared zero frame*/
+	ON_TRANSIT, /*unmapped, being paged out; see frame_wait_transit()*/
 	IMSI_EXTENDED
 };
 
+/* What backs a page once it has to leave its frame. */
+enum page_type {
+	PAGE_ANON, /*stack or modified data, goes to swap */
+	PAGE_FILE, /*clean executable page, re-read from the file */
+	PAGE_MMAP  /*mapped file, written back to the file */
+};
+
+/*
+ * Supplemental page table: a two-level radix tree indexed by the same
+ * bits of the user address as the x86 page directory and page tables,
+ * so a lookup is two array accesses.  Entries are carved out of whole
+ * pages (slabs) owned by the table and recycled through FREE_ENTRIES.
+ */
+struct sup_page_table {
+	struct sup_page_table_entry ***dir; /*one page of leaf pointers*/
+	struct list slabs;
+	struct list free_entries;
+};
+
+/* Pages loaded ahead of a fault on a file-backed page, and on a
+   mapping advised MADV_SEQUENTIAL. */
+#define FAULT_AROUND_PAGES 4
+#define READ_AHEAD_PAGES 16
+
+/* A process may lock at most 1/LOCKED_SHARE of the user pool
+   resident, so that eviction always has frames to choose from. */
+#define LOCKED_SHARE 4
+
 struct sup_page_table_entry 
 {	/*for lazy load*/
 	struct file *file;
@@ -26,23 +56,35 @@ struct sup_page_table_entry
 	uint32_t* user_vaddr; /*upage*/
 	uint64_t access_time;
 
-	struct hash_elem hs_elem;
+	struct thread *owner;
+	struct frame_table_entry *fte; /*frame holding the page, if any*/
+	struct list_elem fte_elem; /*also links free entries of a slab*/
 	int swap_index;
 	bool dirty;
-	bool accessed; /*for swap eviction */
+	bool pinned; /*frame is being filled in, do not evict */
+	bool locked; /*kept resident until unmapped (mmap_populate)*/
 	enum page_location location;
+	enum page_type type;
+	int advice; /*MADV_* hint, mapped-file pages only*/
 
 
 };
 
-void page_init (struct hash *supt);
-struct sup_page_table_entry *allocate_page (struct hash *supt, void *addr);
-void free_page(struct hash_elem *hs_elem, void *aux);
-void destroy_supt(struct hash *supt, void *aux);
-bool load_page(struct sup_page_table_entry *spte);
-unsigned page_hash_hash(const struct hash_elem *element, void *aux );
-bool page_hash_less(const struct hash_elem *a, const struct hash_elem *b, void *aux);
-bool stack_growth(struct hash *supt, void *addr);
+bool page_init (struct sup_page_table *supt);
+struct sup_page_table_entry *allocate_page (struct sup_page_table *supt, void *addr);
+struct sup_page_table_entry *page_lookup (struct sup_page_table *supt, const void *addr);
+void page_remove (struct sup_page_table *supt, struct sup_page_table_entry *spte);
+void free_page(struct sup_page_table *supt, struct sup_page_table_entry *spte);
+void destroy_supt(struct sup_page_table *supt);
+bool load_page(struct sup_page_table_entry *spte, bool write);
+bool page_copy_on_write(struct sup_page_table_entry *spte);
+bool page_fork(struct thread *parent);
+bool page_sync(struct sup_page_table *supt, void *addr, size_t length);
+bool page_advise(struct sup_page_table *supt, void *addr, size_t length, int advice);
+bool page_populate(struct sup_page_table *supt, void *addr, size_t length, bool lock);
+bool page_pin_range(const void *addr, size_t size, bool write);
+void page_unpin_range(const void *addr, size_t size);
+bool stack_growth(struct sup_page_table *supt, void *addr, bool write);
 
 
 
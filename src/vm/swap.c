@@ -5,6 +5,7 @@
 #include "threads/vaddr.h"
 #include <bitmap.h>
 #include <stdio.h>
+#include "threads/malloc.h"
 #define FREE 0
 #define ALLOC 1
 #define FOR_EACH_SECTOR PGSIZE / DISK_SECTOR_SIZE
@@ -18,6 +19,12 @@ static struct bitmap *swap_table;
 /* Protects swap_table */
 static struct lock swap_lock;
 
+/* Number of pages referring to each swap slot.  Pages of a forked
+   process share the slots of their parent's swapped-out pages. */
+static uint16_t *swap_refs;
+
+#define SLOT(INDEX) ((INDEX) / FOR_EACH_SECTOR)
+
 /* 
  * Initialize swap_device, swap_table, and swap_lock.
  */
@@ -27,7 +34,9 @@ swap_init (void)
 	//printf("swap init\n");
 	swap_device = disk_get(1,1);
 	swap_table = bitmap_create(disk_size(swap_device));
+	swap_refs = calloc(disk_size(swap_device) / FOR_EACH_SECTOR + 1, sizeof *swap_refs);
 	lock_init(&swap_lock);
+	lock_set_name(&swap_lock, "swap");
 	//bitmap_set_all(swap_table, true);
 }
 
@@ -49,7 +58,8 @@ swap_in (void *addr, int index)
 	lock_acquire(&swap_lock);
 	//printf("swap in started\n");
 	read_from_disk(addr, index);
-	bitmap_set_multiple(swap_table, index, FOR_EACH_SECTOR, 0);
+	if (--swap_refs[SLOT(index)] == 0)
+		bitmap_set_multiple(swap_table, index, FOR_EACH_SECTOR, 0);
 	//printf("swap in finished\n");
 	lock_release(&swap_lock);
 	return true; 
@@ -83,6 +93,7 @@ swap_out (void *addr)
 	}
 	//printf("swap out started 4\n");
 	write_to_disk(addr, index);
+	swap_refs[SLOT(index)] = 1;
 	//printf("swap out started 5\n");
 	//printf("index = %d\n", index);
 	lock_release(&swap_lock);
@@ -92,7 +103,16 @@ swap_out (void *addr)
 
 void swap_free(int index){
   lock_acquire(&swap_lock);
-  bitmap_set_multiple(swap_table, index, FOR_EACH_SECTOR, 0);
+  if (--swap_refs[SLOT(index)] == 0)
+    bitmap_set_multiple(swap_table, index, FOR_EACH_SECTOR, 0);
+  lock_release(&swap_lock);
+}
+
+/* Add a reference to the slot at INDEX for another page holding
+   the same contents. */
+void swap_dup(int index){
+  lock_acquire(&swap_lock);
+  swap_refs[SLOT(index)]++;
   lock_release(&swap_lock);
 }
 /* 
@@ -5,6 +5,7 @@ void swap_init (void);
 int swap_in (void *addr, int index);
 int swap_out (void *addr);
 void swap_free(int index);
+void swap_dup(int index);
 void read_from_disk (void *frame, int index);
 void write_to_disk (void *frame, int index);
 